@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "span.hpp"
+
+// Bump allocator for buffers that only live inside one step. Allocations
+// come from a list of blocks; Scope hands its space back on exit, and
+// reset() (once per step) folds the blocks into one of the high-water size,
+// so after the first few steps nothing reaches the heap. Not thread-safe:
+// allocate on the stepping thread and share the span with pool workers.
+class StepArena {
+public:
+    // Value-initialised; T must not need a destructor, nothing is destroyed
+    template <class T>
+    Span<T> allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+        if (count == 0) return {};
+        T* p = static_cast<T*>(bump(count * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < count; ++i) new (p + i) T();
+        return Span<T>(p, count);
+    }
+
+    // Everything allocated after construction is released on destruction
+    class Scope {
+    public:
+        explicit Scope(StepArena& a) : arena(a), block(a.current), offset(a.offset), before(a.before) {}
+        ~Scope() { arena.current = block; arena.offset = offset; arena.before = before; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        StepArena& arena;
+        size_t block, offset, before;
+    };
+
+    // Releases everything; keeps (and coalesces) the memory
+    void reset();
+    // Frees the memory too
+    void release();
+
+    size_t capacity() const;
+    // Most bytes in use at once since the last reset(), and over all resets
+    size_t used() const { return stepPeak; }
+    size_t highWater() const { return peak; }
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t current = 0;    // block being bumped
+    size_t offset = 0;     // into blocks[current]
+    size_t before = 0;     // bytes in blocks[0 .. current)
+    size_t stepPeak = 0, peak = 0;
+    static constexpr size_t minBlock = size_t(64) << 10;
+
+    void* bump(size_t bytes, size_t align);
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class PhysicsWorld;
+class ThreadPool;
+
+// One world of a parameter sweep. setup() builds the scene and sets whatever
+// is being swept (G, restitution, airDragCoefficient, reseed(), ...); the
+// runner then steps it until one of the stop conditions holds.
+struct BatchJob {
+    std::function<void(PhysicsWorld&)> setup;
+    std::vector<double> params;     // recorded under BatchRunner::paramNames
+    float dt = 1.0f / 60.0f;
+    uint64_t maxSteps = 1000;
+    double maxWallSeconds = 0.0;    // per world, 0 = no limit
+    // Stop once kinetic energy changes by less than this fraction between
+    // two checks; 0 = off
+    float settleTolerance = 0.0f;
+    // Optional custom stop test
+    std::function<bool(const PhysicsWorld&)> converged;
+    uint32_t checkEvery = 20;       // steps between stop tests
+};
+
+enum class BatchStop : uint8_t { Steps, WallClock, Settled, Converged };
+
+// Diagnostics of one world when it stopped
+struct BatchResult {
+    BatchStop stop = BatchStop::Steps;
+    uint64_t steps = 0;
+    double simTime = 0.0;
+    double wallSeconds = 0.0;
+    uint64_t objects = 0;
+    double kinetic = 0.0;
+    double potential = 0.0;
+    double energyDrift = 0.0;       // (E_end - E_start) / |E_start|
+    double momentum = 0.0;
+    double angularMomentum = 0.0;
+    uint64_t collisions = 0;
+    uint64_t absorbed = 0;
+    uint64_t stateHash = 0;
+};
+
+// Runs many independent worlds on one thread pool, one world per task so a
+// world's own parallel passes run inline on its thread. Worlds are built
+// first, then ordered by estimated cost and packed: large ones run alone and
+// go first, small ones are grouped until a pack is worth a task.
+//
+// Output (".phbr"), little-endian: BatchFileHeader, then `columns` entries
+// of BatchColumn, then each column's `rows` 8-byte values at its offset.
+// Columns: job, stop, steps, sim_time, wall_seconds, objects, kinetic,
+// potential, energy_drift, momentum, angular_momentum, collisions,
+// absorbed, state_hash, then one f64 column per paramNames entry.
+struct BatchFileHeader {
+    char magic[4];      // "PHBR"
+    uint32_t version;   // 1
+    uint64_t rows;
+    uint32_t columns;
+    uint32_t reserved;
+};
+struct BatchColumn {
+    char name[32];      // zero padded
+    uint32_t type;      // 0 = f64, 1 = u64
+    uint32_t reserved;
+    uint64_t offset;    // from the start of the file
+};
+
+class BatchRunner {
+public:
+    // null = ThreadPool::shared(); a pinned pool keeps each world on one core
+    explicit BatchRunner(ThreadPool* pool = nullptr);
+    ~BatchRunner();
+
+    std::vector<std::string> paramNames;
+
+    // Returns the job's index, which is also its row in results()
+    size_t add(BatchJob job);
+    size_t size() const { return jobs.size(); }
+
+    // Runs every job added since the last run
+    void run();
+    const std::vector<BatchResult>& results() const { return finished; }
+
+    bool writeColumnar(const char* path) const;
+
+private:
+    ThreadPool* pool;
+    std::vector<BatchJob> jobs;
+    std::vector<BatchResult> finished;
+
+    struct Slot {
+        std::unique_ptr<PhysicsWorld> world;
+        double cost = 0.0;
+        double startEnergy = 0.0;
+    };
+    void runJob(size_t index, Slot& slot);
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+// Headless locality benchmark for the command line: builds a rotating disc
+// of count bodies, shuffles their storage order (what long orbital mixing
+// tends towards) and times the collision and tree gravity passes, then
+// reorders the objects along the Morton curve and times them again. Prints
+// per-pass times; returns 0 on success.
+int runReorderBenchmark(size_t count, int repeats);
+
+// Replay check with sleeping on: drops count bodies into the box, with
+// gravity changed halfway so sleepers wake, and records the state hash of
+// every step. Then seeks back to step steps / 4 and replays; returns 1 if
+// any replayed step hashes differently.
+int runReplayCheck(size_t count, int steps);
+
+// Fast-math energy check: runs rotating discs of 300 to 2000 bodies with
+// pairwise and tree gravity, each in a precise and a fast-math world, as
+// BatchRunner jobs. Prints both energy drifts; returns 1 if any fast drift
+// is further than PhysicsWorld::fastMathDriftBound from the precise one.
+// The bound is stated for the default 300 steps.
+int runFastMathCheck(int steps);
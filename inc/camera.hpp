@@ -0,0 +1,55 @@
+#pragma once
+#include <algorithm>
+
+// 2D view onto the world: the rectangle centre +- 1/zoom on each axis fills
+// the window (NDC [-1, 1]). zoom = 1 at the origin is the old fixed view.
+struct Camera2D {
+    float centerX = 0.0f;
+    float centerY = 0.0f;
+    float zoom = 1.0f;
+    float minZoom = 0.01f;
+    float maxZoom = 1000.0f;
+
+    // Shader uniform: ndc = (p - view.xy) * view.zw
+    void viewUniform(float out[4]) const {
+        out[0] = centerX; out[1] = centerY;
+        out[2] = zoom;    out[3] = zoom;
+    }
+
+    void viewRect(float& minX, float& minY, float& maxX, float& maxY) const {
+        float half = 1.0f / zoom;
+        minX = centerX - half; maxX = centerX + half;
+        minY = centerY - half; maxY = centerY + half;
+    }
+
+    // Window coordinates (pixels, origin top-left) to world coordinates
+    void screenToWorld(double sx, double sy, int width, int height, float& wx, float& wy) const {
+        float ndcX = static_cast<float>((sx / width) * 2.0 - 1.0);
+        float ndcY = static_cast<float>(1.0 - (sy / height) * 2.0);
+        wx = centerX + ndcX / zoom;
+        wy = centerY + ndcY / zoom;
+    }
+
+    // Move by a window-pixel delta (e.g. a mouse drag)
+    void panPixels(double dx, double dy, int width, int height) {
+        centerX -= static_cast<float>(dx / width * 2.0) / zoom;
+        centerY += static_cast<float>(dy / height * 2.0) / zoom;
+    }
+
+    // Zoom by `factor` keeping the world point under the cursor fixed
+    void zoomAt(double sx, double sy, int width, int height, float factor) {
+        float wx, wy;
+        screenToWorld(sx, sy, width, height, wx, wy);
+        zoom = std::max(minZoom, std::min(maxZoom, zoom * factor));
+        float nx, ny;
+        screenToWorld(sx, sy, width, height, nx, ny);
+        centerX += wx - nx;
+        centerY += wy - ny;
+    }
+
+    void reset() {
+        centerX = 0.0f;
+        centerY = 0.0f;
+        zoom = 1.0f;
+    }
+};
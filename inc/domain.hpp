@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "physics.hpp"
+#include "transport.hpp"
+
+class ThreadPool;
+
+struct DomainConfig {
+    // Extra halo beyond what collisions need (2 x largest radius plus the
+    // distance two bodies can close in one step). Bodies inside the halo are
+    // also summed directly for gravity, so widening it trades traffic for
+    // near-field accuracy.
+    float haloWidth = 0.0f;
+    // Each rank summarises its bodies on summaryCells^2 cells over its own
+    // extent for the other ranks' far field
+    int summaryCells = 16;
+    // Resolution of the x histogram the slab cuts are balanced on
+    int balanceBins = 1024;
+};
+
+// One rank of a run split into vertical slabs, one per process. step()
+// re-balances the slab cuts on the global x distribution, hands bodies that
+// left this slab to their new owner, exchanges halo copies (world.ghosts)
+// and the coarse multipole summaries (world.farField), then steps the world.
+//
+// Positions cross ranks as absolute coordinates (origin + x), so the ranks'
+// origins may differ. Trail and orbit handles are local to a world and are
+// reset when a body migrates. Black hole absorption and tidal forces only
+// see bodies on the same rank.
+class DomainRank {
+public:
+    // Turns off the world's history: a rewind on one rank would desync it
+    DomainRank(PhysicsWorld& world, Transport& transport, DomainConfig config = {});
+
+    // Collective. False if the transport failed (message over capacity or a
+    // rank timed out); the world is then not stepped.
+    bool step(float dt);
+    // Collective. For a start where every rank loaded the same full set:
+    // computes the cuts and drops the bodies outside this rank's slab,
+    // without sending any
+    bool partitionReplicated();
+
+    // Collective. Rank 0 receives every rank's bodies with positions relative
+    // to its own world's origin; other ranks get an empty vector.
+    bool gather(std::vector<PhysicsObject>& out);
+    // Collective. Element-wise sum of values over all ranks, on every rank
+    bool sum(std::vector<double>& values);
+
+    // Slab r covers absolute x in [cuts[r], cuts[r + 1])
+    const std::vector<double>& slabCuts() const { return cuts; }
+    size_t globalObjectCount() const { return globalCount; }
+    size_t migratedLastStep() const { return migrated; }
+
+    PhysicsWorld& world;
+    Transport& transport;
+    DomainConfig config;
+
+private:
+    std::vector<double> cuts;
+    size_t globalCount = 0;
+    size_t migrated = 0;
+    std::vector<Transport::Buffer> outgoing, incoming;
+
+    struct Extent {
+        double minX, maxX;
+        uint64_t count;
+        float maxRadius, maxSpeed;
+    };
+    bool balance(Extent& global);
+    bool migrate();
+    bool exchangeHalo(const Extent& global, float dt);
+    int owner(double x) const;
+};
+
+// Runs body once per rank: the caller is rank 0 and ranks - 1 forked
+// children take the others, all sharing the segment shmName (created here
+// and unlinked on return). Each rank gets its own pool of threadsPerRank
+// threads (0 = hardware threads / ranks) and must use it rather than
+// ThreadPool::shared(), whose threads do not survive fork(). Returns 0 if
+// every rank's body returned 0. POSIX only.
+int launchLocalRanks(int ranks, const char* shmName, size_t capacity, size_t threadsPerRank,
+                     const std::function<int(Transport&, ThreadPool&)>& body);
+
+// Headless decomposed run for the command line: every rank loads input,
+// keeps a 1/ranks share and steps it; rank 0 reports progress and writes the
+// gathered result to output (".phic") if given
+int runDecomposed(int ranks, uint64_t steps, float dt, const char* input, const char* output);
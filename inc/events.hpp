@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "particle.hpp"
+#include "span.hpp"
+
+class ThreadPool;
+
+enum class EventType : uint8_t {
+    Collision,       // value = impulse magnitude
+    Absorption,      // a = black hole, b = body swallowed; value = mass swallowed
+    TidalDisruption, // a = body torn apart, b = the body that tore it; value = its mass
+    Supernova,       // a = the star; value = explosion energy
+    Expiry,          // a = body whose lifetime ran out; value = its age
+};
+constexpr uint32_t eventBit(EventType type) { return 1u << static_cast<uint32_t>(type); }
+constexpr uint32_t kAllEvents = 0x1Fu;
+const char* eventTypeName(EventType type);
+
+struct PhysicsEvent {
+    static constexpr uint32_t none = 0xFFFFFFFFu;
+    EventType type;
+    uint64_t step;          // PhysicsWorld::stepCount during the step
+    uint32_t a, b;          // object indices when emitted; b = none if no second body
+    ObjectType typeA, typeB;
+    float massA, massB;     // before the event
+    float x, y;             // position of a, world-local
+    float value;            // see EventType
+};
+
+// Fixed-capacity single-producer single-consumer ring: only the producer
+// moves tail and only the consumer moves head. A push into a full ring is
+// dropped and counted instead of blocking.
+class EventRing {
+public:
+    void reset(size_t capacity);   // rounded up to a power of two
+
+    bool push(const PhysicsEvent& event) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[t & mask] = event;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <class Fn>
+    void drain(Fn fn) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        for (; h != t; ++h) fn(slots[h & mask]);
+        head.store(h, std::memory_order_release);
+    }
+
+    uint64_t takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+    size_t capacity() const { return slots ? mask + 1 : 0; }
+
+private:
+    std::unique_ptr<PhysicsEvent[]> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+// Typed events out of the step. Each thread of the world's pool emits into
+// its own ring; once per step the world drains the rings (in thread slot
+// order) and hands every subscriber the events its filter selects. Emit
+// sites test wants() first, so with no subscriber an event costs one branch
+// and nothing is built or stored.
+class EventStream {
+public:
+    using Callback = std::function<void(Span<const PhysicsEvent>)>;
+
+    // mask is a set of eventBit()s; returns an id for unsubscribe(). Safe to
+    // call from inside a callback.
+    int subscribe(uint32_t mask, Callback fn);
+    void unsubscribe(int id);
+
+    bool wants(EventType type) const { return (mask & eventBit(type)) != 0; }
+    bool active() const { return mask != 0; }
+
+    // Events a ring can hold per step before further ones are dropped
+    size_t capacity = size_t(1) << 14;
+    // Total dropped since the stream was created
+    uint64_t dropped() const { return droppedTotal; }
+    size_t memoryUsage() const;
+
+    // One ring per thread of pool; the world calls this before a step with
+    // subscribers. Rings are only reallocated when the pool or capacity change.
+    void prepare(const ThreadPool& pool);
+    // From a thread of the prepared pool (or any other thread, as slot 0)
+    void emit(const PhysicsEvent& event);
+    // Delivers everything emitted since the last drain, on the calling thread
+    void drain();
+
+private:
+    struct Subscriber {
+        int id;
+        uint32_t mask;
+        Callback fn;
+    };
+    std::vector<Subscriber> subscribers, added;
+    uint32_t mask = 0;
+    int nextId = 1;
+    bool draining = false;
+
+    const ThreadPool* pool = nullptr;
+    std::unique_ptr<EventRing[]> rings;
+    size_t ringCount = 0;
+    size_t ringCapacity = 0;
+    std::vector<PhysicsEvent> batch, filtered;
+    uint64_t droppedTotal = 0;
+
+    void updateMask();
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Polynomial stand-ins for libm calls on the PhysicsWorld::fastMath paths.
+// Worst errors below were found by sweeping the floats of the stated domain
+// against the double-precision library result, float rounding included.
+
+// atan2 from a degree-9 odd polynomial on [0, 1] (Abramowitz & Stegun
+// 4.4.49) and octant folding. Absolute error under 1.2e-5 rad;
+// fastAtan2(0, 0) = 0 and the sign of zero is not kept.
+inline float fastAtan2(float y, float x) {
+    const float ax = std::fabs(x), ay = std::fabs(y);
+    const float hi = std::max(ax, ay), lo = std::min(ax, ay);
+    if (hi == 0.0f) return 0.0f;
+    const float z = lo / hi;
+    const float z2 = z * z;
+    float r = z * (0.9998660f + z2 * (-0.3302995f + z2 * (0.1801410f + z2 * (-0.0851330f + z2 * 0.0208351f))));
+    if (ay > ax) r = 1.57079633f - r;
+    if (x < 0.0f) r = 3.14159265f - r;
+    return y < 0.0f ? -r : r;
+}
+
+// log10 for positive normal x: exponent from the bits, the mantissa folded
+// into [sqrt(1/2), sqrt(2)) and ln m = 2 atanh(t) to t^7. Absolute error
+// under 6e-6, most of it the rounding of results far from zero.
+inline float fastLog10(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int exponent = static_cast<int>((bits >> 23) & 0xFFu) - 127;
+    bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    if (m > 1.41421356f) {
+        m *= 0.5f;
+        ++exponent;
+    }
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    const float lnM = 2.0f * t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+    return (static_cast<float>(exponent) * 0.693147181f + lnM) * 0.434294482f;
+}
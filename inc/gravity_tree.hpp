@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "particle.hpp"
+
+// Barnes-Hut quadtree over point masses. A node whose size / distance is
+// below the opening angle theta is treated as a single mass at its centre of
+// mass; theta = 0 degenerates to the exact pairwise sum.
+class GravityTree {
+public:
+    static constexpr uint32_t kLeafSize = 8;
+
+    void build(const std::vector<Particle>& objects, bool includeStatic);
+    bool empty() const { return nodes.empty(); }
+    size_t memoryUsage() const;
+
+    // Sum of m * d / |d|^3 over the tree at (x, y), with softeningSq added to
+    // |d|^2. Body `skip` (an index into the objects passed to build) and
+    // bodies closer than 1e-4 are ignored. Offsets are taken in Real and
+    // summed in Accum (see precision.hpp).
+    void field(Real x, Real y, float theta, float softeningSq,
+               Accum& gx, Accum& gy, int skip = -1) const;
+
+private:
+    struct Node {
+        Real comX, comY;
+        float mass;
+        Real centerX, centerY, half;  // square bounds
+        int firstChild;               // 4 consecutive children, -1 for leaves
+        uint32_t begin, count;        // range in `order`
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> order;       // object indices, grouped by node
+    std::vector<Real> bx, by;          // body data, in `order` order
+    std::vector<float> bm;
+
+    void subdivide(const std::vector<Particle>& objects, size_t node, int depth);
+};
@@ -1,19 +1,47 @@
 #pragma once
 #include <vector>
+#include <cstdint>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "camera.hpp"
+#include "gravity_tree.hpp"
 
 class PhysicsWorld;
+class LineBatch;
 
 // Handles drawing the gravity field grid and axes
 class GridRenderer {
 public:
     GridRenderer(int fieldN = 20, float arrowScale = 0.07f, float arrowAlpha = 0.25f);
     void drawAxes(GLuint axisProgram, GLuint axisVAO, int axisVertexCount);
-    void drawField(const PhysicsWorld& world, GLuint axisProgram, GLint colorLoc);
+    // Adds one arrow (shaft + two head strokes) per sample to `lines`;
+    // samples cover the camera's view rectangle
+    void drawField(const PhysicsWorld& world, const Camera2D& camera, LineBatch& lines);
+    
+    // Samples per axis; arrows shrink to keep dense grids readable
+    void setFieldResolution(int n);
+    int fieldResolution() const { return fieldN; }
+    
+    // Above this many objects the field is sampled through the Barnes-Hut
+    // tree (at the world's gravityTheta, or fieldTheta if that is exact)
+    size_t treeThreshold = 512;
+    float fieldTheta = 0.5f;
+    
 private:
     int fieldN;
     float arrowScale;
     float arrowAlpha;
+    
+    // Field sampled at the fieldN x fieldN points, reused while the world and view are unchanged
+    std::vector<float> fieldGX, fieldGY, fieldNorm;
+    GravityTree fieldTree;  // kept so rebuilding it reuses the storage
+    float sampleX0 = -1.0f, sampleY0 = -1.0f, sampleStep = 0.0f;
+    float logMinG = 0.0f, logMaxG = 1.0f;
+    const PhysicsWorld* cachedWorld = nullptr;
+    uint64_t cachedRevision = 0;
+    size_t cachedCount = 0;
+    int cachedN = 0;
+    bool cachedFast = false;
+    
+    void computeField(const PhysicsWorld& world, const Camera2D& camera);
 };
-
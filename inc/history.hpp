@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "particle.hpp"
+
+class PhysicsWorld;
+
+// Bounded-memory rewind buffer. Every `keyframeInterval` steps a full copy of
+// the object list is stored; the steps in between only keep the particles
+// whose per-step state actually changed. Once `memoryBudget` is exceeded the
+// oldest keyframe and its deltas are dropped.
+class SimulationHistory {
+public:
+    bool enabled = true;
+    size_t keyframeInterval = 60;
+    size_t memoryBudget = 64u * 1024u * 1024u; // bytes
+
+    // Capture the world state at world.stepCount. Recording a step that is not
+    // newer than the newest frame (e.g. after a seek) discards the old future.
+    void record(const PhysicsWorld& world);
+
+    // Restore the world to any retained step. Returns false if it was evicted.
+    bool seek(uint64_t step, PhysicsWorld& world);
+
+    void clear();
+    // The objects were reordered or edited beyond their per-step state, which
+    // a delta cannot express; the next record() stores a keyframe
+    void forceKeyframe() { lastState.clear(); }
+
+    bool empty() const { return segmentCount == 0; }
+    uint64_t oldestStep() const;
+    uint64_t newestStep() const;
+    size_t frameCount() const;
+    size_t memoryUsage() const { return bytesUsed; }
+
+private:
+    // Per-step mutable state of a particle; anything else changing (type,
+    // colour, object count) forces a keyframe.
+    struct HotState {
+        Real x, y, vx, vy;
+        float mass, radius;
+        float spin, spinAngle, orbitAngle;
+        float temperature, age;
+        float sleepTime;
+        float sleepPullX, sleepPullY;
+        uint32_t sleepIsland;
+        bool sleeping;
+    };
+
+    struct StatsSnapshot {
+        size_t totalCollisions;
+        size_t objectsAbsorbed;
+        float totalEnergyLost;
+        double originX, originY;    // world origin the positions are relative to
+        uint64_t randomStreams;     // scenario RNG streams drawn so far
+        // Gravity and walls the sleepers came to rest under, so a replay wakes them alike
+        float sleepGravity;
+        std::array<float, 4> sleepWalls;
+        bool sleepOpen;
+        uint32_t sleepIslandCount;  // island labels handed out so far
+    };
+
+    struct Delta {
+        uint64_t step;
+        StatsSnapshot stats;
+        std::vector<uint32_t> indices;
+        std::vector<HotState> states;
+    };
+
+    struct Segment {
+        uint64_t step;                  // step of the keyframe
+        StatsSnapshot stats;
+        // Keyframe bodies with their components left empty; body i's are
+        // components[componentStart[i] .. componentStart[i + 1])
+        std::vector<Particle> keyframe;
+        std::vector<uint32_t> componentStart;
+        std::vector<Particle> components;
+        std::vector<Delta> deltas;      // consecutive steps after the keyframe
+        size_t bytes = 0;
+
+        uint64_t lastStep() const { return deltas.empty() ? step : deltas.back().step; }
+    };
+
+    // Segments oldest first in a ring: segment k is
+    // ring[(ringFirst + k) % ring.size()]. A dropped segment leaves its
+    // storage in the slot for the next one; the ring only grows when full.
+    std::vector<Segment> ring;
+    size_t ringFirst = 0;
+    size_t segmentCount = 0;
+    size_t bytesUsed = 0;
+
+    // State at the newest recorded (or last sought) step, used for diffing
+    std::vector<HotState> lastState;
+    std::vector<ObjectType> lastTypes;
+    // Changes of the step being recorded, copied into the Delta at their final size
+    std::vector<uint32_t> changedIndices;
+    std::vector<HotState> changedStates;
+    // Deltas of dropped frames, reused by the next ones so recording at the
+    // budget does not allocate
+    std::vector<Delta> spareDeltas;
+
+    static HotState capture(const Particle& p);
+    static void apply(const HotState& s, Particle& p);
+    static StatsSnapshot captureStats(const PhysicsWorld& world);
+    // Both count capacity, which reused storage may have more of than it needs
+    static size_t keyframeBytes(const Segment& seg);
+    static size_t deltaBytes(const Delta& d);
+
+    Segment& segment(size_t k) { return ring[(ringFirst + k) % ring.size()]; }
+    const Segment& segment(size_t k) const { return ring[(ringFirst + k) % ring.size()]; }
+    Segment& newest() { return segment(segmentCount - 1); }
+    Segment& pushSegment();
+
+    void truncateFrom(uint64_t step);
+    void pushKeyframe(const PhysicsWorld& world);
+    void rememberState(const std::vector<Particle>& objects);
+    void enforceBudget();
+    void recycle(Segment& seg);
+    void recycle(Delta& delta);
+};
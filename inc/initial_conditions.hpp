@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "particle.hpp"
+
+class PhysicsWorld;
+
+// Loaders for externally generated initial conditions. Both map the file,
+// size world.objects once and fill the new objects in parallel; nothing goes
+// through addObject and there are no overlap checks.
+//
+// Columnar binary (".phic"), little-endian:
+//   ColumnarHeader, then each present column in IcColumn order, every column
+//   `count` values long and starting on an 8-byte boundary.
+//   x, y, vx, vy are f64 with IcDoublePositions set, else f32; radius, mass
+//   and temperature are f32; type is u8 (an ObjectType); color is 3 x f32.
+//   Columns whose type matches the build's storage are read in place.
+//
+// CSV: a header line naming the columns (x, y, vx, vy, radius, mass, type,
+//   r, g, b, temperature; any order, unknown names ignored), then one body
+//   per line. type is an ObjectType number or name ("star", "blackhole", ...).
+//
+// Missing columns keep the Particle defaults, except radius (0.01) and mass
+// (1). Bodies without a colour get their type's usual colour and properties.
+//
+// Positions in files are absolute: the loaders subtract the world's origin
+// and exportColumnar adds it back.
+
+enum IcColumn : uint32_t {
+    IcX = 1u << 0, IcY = 1u << 1, IcVX = 1u << 2, IcVY = 1u << 3,
+    IcRadius = 1u << 4, IcMass = 1u << 5, IcType = 1u << 6, IcColor = 1u << 7,
+    IcTemperature = 1u << 8,
+    IcColumnCount = 9
+};
+enum IcFlags : uint32_t { IcDoublePositions = 1u << 0 };
+
+struct ColumnarHeader {
+    char magic[4];      // "PHIC"
+    uint32_t version;   // 1
+    uint64_t count;
+    uint32_t columns;   // IcColumn bits
+    uint32_t flags;     // IcFlags bits
+    uint64_t reserved;
+};
+static_assert(sizeof(ColumnarHeader) == 32, "on-disk header layout");
+
+struct ImportResult {
+    size_t imported = 0;
+    std::string error;  // empty on success; nothing is added on failure
+    explicit operator bool() const { return error.empty(); }
+};
+
+ImportResult importColumnar(PhysicsWorld& world, const char* path);
+ImportResult importCsv(PhysicsWorld& world, const char* path);
+// Picks the loader by extension: ".csv" is CSV, anything else columnar
+ImportResult importInitialConditions(PhysicsWorld& world, const char* path);
+
+// Writes every object's columns; positions and velocities are f64 in a
+// double build or once the origin is nonzero, else f32
+bool exportColumnar(const PhysicsWorld& world, const char* path);
+
+// ObjectType for a CSV name or number; false if it is neither
+bool parseObjectType(const char* begin, const char* end, ObjectType& type);
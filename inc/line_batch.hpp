@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include "stream_buffer.hpp"
+#include "particle.hpp"
+#include "camera.hpp"
+
+// Collects coloured line segments (field arrows, orientation markers, trails)
+// and draws them from one streamed buffer with one glDrawArrays per distinct
+// line width, instead of a VAO/VBO or glBegin per segment.
+class LineBatch {
+public:
+    bool init();
+    void destroy();
+
+    // Vertices are in world coordinates; the camera is applied at flush
+    void setView(const Camera2D& camera);
+    void addLine(float x0, float y0, float x1, float y1, const Color3& c, float alpha = 1.0f, float width = 1.0f);
+    // Per-vertex colours, e.g. a trail fading out towards its tail
+    void addLine(float x0, float y0, const Color3& c0, float a0,
+                 float x1, float y1, const Color3& c1, float a1, float width = 1.0f);
+
+    // Upload everything added since the last flush and draw it
+    void flush();
+    size_t segmentCount() const;
+
+private:
+    struct Vertex {
+        float x, y;
+        float r, g, b, a;
+    };
+    struct Bucket {
+        float width;
+        std::vector<Vertex> vertices;
+    };
+
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLint viewLoc = -1;
+    float view[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    StreamBuffer stream;
+    std::vector<Bucket> buckets; // few distinct widths, kept across frames
+
+    std::vector<Vertex>& bucketFor(float width);
+};
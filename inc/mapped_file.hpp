@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are faulted in as they are
+// touched, so readers can work straight out of the mapping without a copy.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file cannot be opened or mapped; an empty file maps fine
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
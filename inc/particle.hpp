@@ -2,6 +2,8 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <cstdint>
+#include "precision.hpp"
 
 // Color struct for rendering
 struct Color3 {
@@ -32,28 +34,83 @@ enum class ObjectType {
     RockyPlanet   // NEW: Small terrestrial planet
 };
 
-// Trail system for visual effects
+// Trail system for visual effects: a fixed-capacity ring of points living
+// in a TrailPool. Points are stored as x,y pairs at [offset, offset + capacity).
 struct Trail {
-    std::vector<float> positions; // x1,y1,x2,y2,...
-    size_t maxPoints = 100;
-    float fadeRate = 0.98f;
+    uint32_t offset = 0;     // first point slot in the pool
+    uint32_t capacity = 0;   // ring size in points
+    uint32_t head = 0;       // slot the next point is written to
+    uint32_t count = 0;      // points currently stored
+    uint32_t tick = 0;       // points offered, for decimation
+    bool inUse = false;
+    // Boxes (min x, min y, max x, max y) of the points written in the
+    // current lap of the ring and in the lap before it; between them they
+    // cover every stored point
+    float lapBox[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float prevLapBox[4] = {0.0f, 0.0f, 0.0f, 0.0f};
     
-    void addPoint(float x, float y);
-    void update();
-    void clear();
+    // The stored points, oldest first, as at most two contiguous pool ranges
+    void ranges(uint32_t& first0, uint32_t& count0, uint32_t& first1, uint32_t& count1) const;
+    // False only if no stored point lies in the rectangle
+    bool mayTouch(float minX, float minY, float maxX, float maxY) const;
+    void resetBounds();
 };
 
-// Particle/physics object
-struct Particle {
-    float x, y;
-    float vx, vy;
-    float radius;
-    float mass;
+struct Particle;
+
+// Owns the storage of every trail in a world as one contiguous float array,
+// so appends are O(1) and the renderer can upload it as a single buffer.
+// Released rings are recycled for later trails of the same size.
+class TrailPool {
+public:
+    uint32_t decimation = 1; // keep every k-th point offered to a trail
+    
+    int allocate(uint32_t capacity);
+    void release(int handle);
+    void addPoint(int handle, float x, float y);
+    void clear(int handle);
+    void clearAll();
+    // Move every stored point by (-dx, -dy), for origin rebasing
+    void translate(float dx, float dy);
+    
+    // Give every particle with trailLength > 0 a ring of its own of that many
+    // points and release rings no particle references (objects are erased
+    // and copied freely, and trailLength may change).
+    void sync(std::vector<Particle>& objects);
+    
+    bool valid(int handle) const {
+        return handle >= 0 && handle < static_cast<int>(trails.size()) && trails[handle].inUse;
+    }
+    const Trail& trail(int handle) const { return trails[handle]; }
+    // Rings currently allocated (including any whose particle is gone until
+    // the next sync)
+    size_t liveCount() const { return live; }
+    const std::vector<Trail>& allTrails() const { return trails; }
+    
+    // Contiguous x,y storage for all trails
+    const float* data() const { return points.data(); }
+    size_t pointCapacity() const { return points.size() / 2; }
+    size_t memoryUsage() const;
+    
+private:
+    std::vector<float> points;
+    std::vector<Trail> trails;
+    std::vector<int> freeList;
+    std::vector<uint8_t> claimed; // scratch for sync()
+    size_t live = 0;
+};
+
+// Every member of a particle but its components, so it can be copied
+// without allocating (history keyframes keep components apart)
+struct ParticleFields {
+    Real x = 0, y = 0;           // see precision.hpp
+    Real vx = 0, vy = 0;
+    float radius = 0.0f;
+    float mass = 0.0f;
     float charge = 0.0f;
     bool isStatic = false;
     ObjectType type = ObjectType::Normal;
     Color3 color = {1.0f, 0.0f, 0.0f};
-    std::vector<Particle> components;
     
     // Celestial properties
     float eventHorizon = 0.0f;
@@ -66,7 +123,8 @@ struct Particle {
     // Visual effects
     float spin = 0.0f;
     float spinAngle = 0.0f;
-    std::shared_ptr<Trail> trail; // Optional trail rendering
+    int trail = -1;               // Handle into PhysicsWorld::trails
+    uint32_t trailLength = 0;     // Requested trail points, 0 = no trail
     
     // NEW: Enhanced physics properties
     float temperature = 273.0f;  // Kelvin
@@ -85,6 +143,20 @@ struct Particle {
     // NEW: Tidal locking for moons
     bool tidallyLocked = false;
     
+    // Resting, see PhysicsWorld::allowSleeping. A sleeping body is not
+    // integrated, has zero velocity and only wakes through the world.
+    bool sleeping = false;
+    float sleepTime = 0.0f;       // seconds spent below the sleep thresholds
+    uint32_t sleepIsland = 0;     // shared by bodies that fell asleep touching
+    // Velocity body-body gravity gave the body per substep when it fell
+    // asleep; NaN until the first gravity pass after that
+    float sleepPullX = 0.0f, sleepPullY = 0.0f;
+};
+
+// Particle/physics object
+struct Particle : ParticleFields {
+    std::vector<Particle> components;
+    
     // Constructor
     Particle() = default;
     
@@ -122,6 +194,10 @@ namespace ParticleUtils {
     // NEW: Temperature-based color for stars
     Color3 getTemperatureColor(float temp);
     
+    // Colour and the properties the presets below give p.type, for bodies
+    // built field by field; colour and temperature are kept if already set
+    void applyTypeDefaults(Particle& p, bool hasColor, bool hasTemperature);
+    
     // NEW: Create preset objects
     Particle createStar(float x, float y, float mass, float temp = 5778.0f);
     Particle createPlanet(float x, float y, float radius, float mass, bool gasGiant = false);
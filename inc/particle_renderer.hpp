@@ -0,0 +1,38 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "stream_buffer.hpp"
+#include "camera.hpp"
+
+class PhysicsWorld;
+
+// Draws every object as an instanced screen-aligned quad. Per-object data is
+// streamed into one instance buffer per frame and the per-type look (black
+// hole ring, star glow, planet halo, merged outline) is done in the shader.
+class ParticleRenderer {
+public:
+    bool init();
+    // Draws objects[visible[i]]; sizes scale with the camera zoom
+    void draw(const PhysicsWorld& world, const std::vector<size_t>& visible,
+              const Camera2D& camera, int fbWidth, int fbHeight);
+    void destroy();
+
+    // Draw sleeping bodies washed out towards blue-grey
+    bool tintSleeping = false;
+
+private:
+    struct Instance {
+        float x, y;
+        float size;    // core diameter in pixels
+        float aux;     // black holes: event horizon diameter in pixels
+        float r, g, b;
+        float type;    // ObjectType
+    };
+
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint quadVBO = 0;
+    GLint viewportLoc = -1;
+    GLint viewLoc = -1;
+    StreamBuffer instances;
+};
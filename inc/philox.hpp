@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Counter-based generator (Philox4x32-10, Salmon et al. 2011). Every
+// (key, counter) pair maps to four independent 32-bit values with no state in
+// between, so element i of a batch can draw its numbers on any thread, in any
+// order, and still get the same ones.
+class Philox {
+public:
+    using Block = std::array<uint32_t, 4>;
+
+    explicit Philox(uint64_t key = 0)
+        : k0(static_cast<uint32_t>(key)), k1(static_cast<uint32_t>(key >> 32)) {}
+
+    // Four values for counter (hi, lo); callers use hi for a stream, lo for an element
+    Block operator()(uint64_t hi, uint64_t lo) const {
+        Block c = {static_cast<uint32_t>(lo), static_cast<uint32_t>(lo >> 32),
+                   static_cast<uint32_t>(hi), static_cast<uint32_t>(hi >> 32)};
+        uint32_t a = k0, b = k1;
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c[0];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c[2];
+            c = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ a, static_cast<uint32_t>(p1),
+                 static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ b, static_cast<uint32_t>(p0)};
+            a += 0x9E3779B9u;
+            b += 0xBB67AE85u;
+        }
+        return c;
+    }
+
+    // Uniform in [lo, hi) from the top 24 bits of v
+    static float uniform(uint32_t v, float lo, float hi) {
+        return lo + (hi - lo) * ((v >> 8) * (1.0f / 16777216.0f));
+    }
+
+private:
+    uint32_t k0, k1;
+};
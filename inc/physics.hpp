@@ -2,10 +2,52 @@
 #include <vector>
 #include <functional>
 #include <cmath>
+#include <array>
+#include <utility>
 #include "particle.hpp"
+#include "history.hpp"
+#include "span.hpp"
+#include "gravity_tree.hpp"
+#include "spatial_hash.hpp"
+#include "philox.hpp"
+#include "events.hpp"
+#include "arena.hpp"
+
+class ThreadPool;
 
 using PhysicsObject = Particle;
 
+// Pull of a group of bodies held elsewhere (another domain rank): total mass
+// at the centre of mass plus the traceless quadrupole about it,
+// Q_ij = sum m (3 d_i d_j - |d|^2 delta_ij)
+struct FarFieldSource {
+    Real x, y;
+    float mass;
+    float qxx, qxy, qyy;
+};
+
+// How addObjects treats a new object that overlaps one already in the world
+enum class OverlapPolicy {
+    Reject, // drop it, as addObject does (earlier objects of the batch count too)
+    Allow   // append unconditionally
+};
+
+// Two objects, i < j, listed as neighbours (see PhysicsWorld::neighbourSkin)
+struct NeighbourPair {
+    uint32_t i, j;
+};
+
+// Bytes held by a world, by subsystem (capacity, not just what is in use)
+struct MemoryUsage {
+    size_t particles = 0;  // objects and ghosts
+    size_t grid = 0;       // spatial grid, hashed grids, gravity tree
+    size_t trails = 0;
+    size_t history = 0;
+    size_t fields = 0;     // force fields and the baked field grid
+    size_t scratch = 0;    // step arena and per-pass scratch buffers
+    size_t total() const { return particles + grid + trails + history + fields + scratch; }
+};
+
 // NEW: Force field system for custom physics
 struct ForceField {
     enum Type { RADIAL, DIRECTIONAL, VORTEX, CUSTOM };
@@ -14,10 +56,26 @@ struct ForceField {
     float strength;
     float radius;        // Influence radius
     float angle = 0.0f;  // For directional forces
+    // Legacy per-object callback, called once per object inside the radius
     std::function<void(PhysicsObject&, float, float)> customForce;
+    // Preferred: called once per step with every non-static object inside the
+    // radius. Velocities written to vx/vy are stored back to the objects.
+    std::function<void(const ForceField&, Span<const float> x, Span<const float> y,
+                       Span<float> vx, Span<float> vy)> customBatch;
     bool active = true;
 };
 
+// All bakeable force fields rasterised onto a regular grid of per-substep
+// velocity increments, sampled bilinearly. Zero outside the baked domain.
+struct BakedFieldGrid {
+    int cols = 0, rows = 0;
+    float x0 = 0.0f, y0 = 0.0f;
+    float spacingX = 1.0f, spacingY = 1.0f;
+    std::vector<float> dvx, dvy; // row-major, rows * cols
+
+    void sample(float x, float y, float& outX, float& outY) const;
+};
+
 class PhysicsWorld {
 public:
     std::vector<PhysicsObject> objects;
@@ -32,11 +90,35 @@ public:
     int gridCols = 20;
     float cellWidth = 0.1f;
     float cellHeight = 0.1f;
-    std::vector<std::vector<std::vector<size_t>>> gridCells;
+    // Objects binned by cell, row-major and in index order within a cell:
+    // cell (row, col) holds gridCellItems[gridCellStart[c] .. gridCellStart[c + 1])
+    // with c = row * gridCols + col. Empty until the grid is built.
+    std::vector<uint32_t> gridCellStart;
+    std::vector<size_t> gridCellItems;
+    Span<const size_t> gridCell(int row, int col) const {
+        size_t c = static_cast<size_t>(row) * gridCols + col;
+        return Span<const size_t>(gridCellItems.data() + gridCellStart[c], gridCellStart[c + 1] - gridCellStart[c]);
+    }
+
+    // Open boundary: no walls, and collisions and neighbour queries use a
+    // sparse hashed grid instead of the cell grid, so the domain is unbounded.
+    // Cells are hashCellSize wide (at least the largest diameter).
+    bool openBoundary = false;
+    float hashCellSize = 0.1f;
+    SpatialHashGrid hashGrid;
+
+    // Storage for every object's trail (see Particle::trail)
+    TrailPool trails;
 
     // NEW: Force fields system
     std::vector<ForceField> forceFields;
     
+    // Baked mode: RADIAL/VORTEX/DIRECTIONAL fields are rasterised into a grid
+    // whenever the field set changes and objects sample it in a single pass.
+    // CUSTOM fields are still evaluated analytically.
+    bool bakeForceFields = false;
+    int forceFieldBakeResolution = 128;
+    
     // NEW: Global physics settings
     float airDragCoefficient = 0.0f;  // Atmospheric drag
     bool relativisticEffects = false;  // Enable relativistic corrections near black holes
@@ -50,9 +132,150 @@ public:
         void reset() { totalCollisions = 0; objectsAbsorbed = 0; totalEnergyLost = 0.0f; }
     } stats;
 
+    // Per-event records (collisions, absorptions, disruptions, supernovae,
+    // expiries), delivered to subscribers at the end of each step()
+    EventStream events;
+    
+    // Rewind buffer, recorded at the end of every step()
+    uint64_t stepCount = 0;
+    SimulationHistory history;
+    
+    // Bumped whenever objects change through the world (step, add, remove,
+    // seek), so derived data such as the rendered field can be cached. Code
+    // that edits objects directly must call markObjectsChanged() afterwards.
+    uint64_t revision = 0;
+    void markObjectsChanged() { invalidateNeighbours(); ++revision; }
+    
+    // Domain decomposition hooks (see domain.hpp). Every gravity pass adds
+    // the pull of farField; ghosts are copies of nearby bodies owned by other
+    // ranks, which collide with this world's bodies but are not moved here.
+    std::vector<FarFieldSource> farField;
+    std::vector<PhysicsObject> ghosts;
+    
+    // Gravitational constant for body-body attraction, the diagnostics and
+    // the orbital speeds of the scenario helpers
+    double G = gravitationalConstant<double>();
+    // Coefficient of restitution for body-body collisions
+    float restitution = 0.95f;
+    
+    // Barnes-Hut opening angle for applyGravityForces; 0 = exact pairwise sum
+    float gravityTheta = 0.0f;
+    GravityTree gravityTree;
+    // Evaluate pairwise gravity in float even when Real is double (the mixed
+    // policy at run time); no effect in a single-precision build
+    bool singlePrecisionForces = false;
+    // Fast-math kernels, for speed over the last bits: pair terms take one
+    // root and one divide (1 / |d|, reused) instead of a divide per
+    // component, pairwise gravity sums each row before scaling it and drops
+    // its 1e-6 distance offset, radius cutoffs compare squared distances,
+    // and tidal locking and the field colours use the polynomial atan2 and
+    // log10 of fast_math.hpp (errors under 1.2e-5 rad and 6e-6). Pair terms
+    // stay within a few ulps of the precise ones; hashes only match between
+    // worlds in the same mode. Over 300 steps of 300-2000 body discs, the
+    // fast world's energy drift stays within fastMathDriftBound (0.4% of
+    // |E0|) of the precise world's, 0.16% at worst as measured; longer runs
+    // drift apart as close passes amplify the difference. The fast_math
+    // test (PhysicsChecks --check-fast-math) reruns the check.
+    bool fastMath = false;
+    static constexpr double fastMathDriftBound = 0.004;
+    
+    // Pool for the per-body passes (gravity) and diagnostics;
+    // null uses ThreadPool::shared(). Per-body passes write only their own
+    // body, so they give the same bits for any thread count.
+    ThreadPool* threadPool = nullptr;
+    ThreadPool& pool() const;
+    // Sum diagnostics in fixed-size blocks, combined in block order, instead
+    // of one partial per pool chunk (chunking depends on the thread count).
+    // Collision pairs are resolved serially, in index order with neighbour
+    // lists (useNeighbourLists) and in grid order without, so with this on
+    // the whole state is bitwise reproducible across thread counts.
+    bool deterministic = true;
+    
+    // Scenario helpers draw from a Philox stream keyed by seed, one stream
+    // per call, so the same seed and call sequence always builds the same scene
+    uint64_t seed = 0x5EED5EED5EED5EEDull;
+    void reseed(uint64_t newSeed) { seed = newSeed; randomStreams = 0; }
+    
+    // Hash of every object's state (sleep included) and the origin; equal
+    // worlds hash equal
+    uint64_t stateHash() const;
+    // Compute stateHash() at the end of every step into lastStateHash, and
+    // print it when logStateHash is set
+    bool hashEveryStep = false;
+    bool logStateHash = false;
+    uint64_t lastStateHash = 0;
+    
+    // Positions are relative to this origin. rebaseOrigin() moves it, so the
+    // region of interest stays near zero where float positions are densest;
+    // with autoRebase the heaviest body is re-centred once it is further than
+    // rebaseDistance from the origin.
+    double originX = 0.0;
+    double originY = 0.0;
+    bool autoRebase = false;
+    float rebaseDistance = 50.0f;
+    void rebaseOrigin(double worldX, double worldY);
+
     void updateSpatialGrid();
+    // Rebuild the grid only if objects changed since it was last built
+    void ensureSpatialGrid();
+    // Largest radius / event horizon seen by the last grid build
+    float gridMaxRadius() const { return gridMaxExtent; }
+    // Verlet neighbour lists: every pair closer than the sum of their radii
+    // plus neighbourSkin, found through the grid. The list stays valid until
+    // some body has moved (or grown) by more than half the skin since it was
+    // built, or objects were added or removed, so collisions re-enumerate the
+    // grid only every several substeps. Pairs are sorted by index.
+    // The skin is capped at what the grid can see (a cell less the largest
+    // diameter); a wider skin rebuilds less often but lists more pairs.
+    bool useNeighbourLists = true;
+    float neighbourSkin = 0.05f;
+    // Rebuilds the lists if they are stale; step() calls this before collisions
+    void updateNeighbourLists();
+    Span<const NeighbourPair> neighbourPairs() const { return neighbours; }
+    // Forces a rebuild; needed after editing objects directly in a way that
+    // keeps their count (the world's own adds and removals call it)
+    void invalidateNeighbours() { neighboursValid = false; }
+    size_t neighbourRebuilds = 0;
+
+    // Locality reordering: objects are sorted along a Z-order (Morton) curve
+    // of their positions so bodies near in space are near in memory for the
+    // grid, collision and tree passes. Every reorderInterval steps the
+    // disorder is measured and, above reorderThreshold, the objects are
+    // sorted at the end of the step. Object indices are not stable while this
+    // is on: orbitTarget is remapped, and reorderMap() gives anything else
+    // holding indices the new index of each old one.
+    bool reorderObjects = false;
+    uint32_t reorderInterval = 64;
+    float reorderThreshold = 0.1f;
+    // Fraction of consecutive objects out of curve order, on a grid coarse
+    // enough to hold about 16 bodies per cell: 0 just after a reorder, about
+    // 0.5 for a random order
+    float localityDisorder();
+    void reorderForLocality();
+    Span<const uint32_t> reorderMap() const { return reorderRemap; }
+    size_t reorderCount = 0;
+
+    // Indices of all objects within r of (x, y), using the current spatial grid
+    void queryRadius(float x, float y, float r, std::vector<size_t>& out) const;
+    // Indices of all objects whose centre lies in the rectangle grown by margin
+    void queryRect(float minX, float minY, float maxX, float maxY, float margin, std::vector<size_t>& out) const;
     void addObject(const PhysicsObject& obj);
+    // Erases objects[index] and wakes whatever rested on it
+    void removeObject(size_t index);
+    void clearObjects();
+    // Appends a batch with one reserve; overlap checks go through a temporary
+    // hashed grid instead of a scan per object. Returns how many were added.
+    size_t addObjects(Span<const PhysicsObject> batch, OverlapPolicy policy = OverlapPolicy::Reject);
+    // Appends count default objects and returns them for a bulk loader to
+    // fill in place (from any thread); no overlap checks
+    Span<PhysicsObject> appendObjects(size_t count);
+    // Capacity for count objects in the objects and the per-object buffers,
+    // so growing up to it does not reallocate mid-step
+    void reserve(size_t count);
+    MemoryUsage memoryUsage() const;
+    // Runs the stepImpl instantiation matching activeStepFeatures()
     void step(float dt);
+    unsigned activeStepFeatures() const;
     void handleCollisions();
     void handleWalls();
     void applyGravityForces();
@@ -78,12 +301,156 @@ public:
     void addForceField(const ForceField& field);
     void removeForceField(size_t index);
     void clearForceFields();
+    void setForceFieldActive(size_t index, bool active);
+    // Call after editing forceFields directly so the baked grid is rebuilt
+    void markForceFieldsDirty() { forceFieldsDirty = true; }
     
     // NEW: Scenario helpers
     void createGalaxy(float centerX, float centerY, int armCount, int starsPerArm);
     void createAsteroidBelt(float centerX, float centerY, float innerR, float outerR, int count);
     
+    // Sleeping: a body that stays under sleepSpeed and sleepEnergy for
+    // timeToSleep seconds is still. Touching bodies form an island, and an
+    // island of still bodies resting on a wall, a static body or a sleeping
+    // one falls asleep as a whole. Sleeping bodies keep pulling and blocking
+    // others but are not integrated or collided with each other. Moving
+    // contacts, force fields, supernova blasts, removals nearby and changes
+    // to gravity or the walls wake them, and waking one body wakes every
+    // body that fell asleep in the same island (by the end of the substep).
+    // A sleeper is also woken when the pull of the other bodies on it has
+    // changed by more than wakePull (velocity per substep) since it fell
+    // asleep, e.g. as a mass approaches. Call wakeObject() after editing a
+    // body directly.
+    bool allowSleeping = true;
+    float sleepSpeed = 0.05f;
+    float sleepEnergy = 1e-3f;
+    float timeToSleep = 0.5f;
+    float wakePull = 1e-3f;
+    void wakeObject(size_t index);
+    void wakeAll();
+    // Wakes sleeping bodies that overlap the circle
+    void wakeRegion(Real x, Real y, float radius);
+    size_t sleepingCount() const;
+    
+    // Most substeps a step() is split into; 0 = as many as fast bodies need
+    // to move under half a unit per substep. A cap bounds the cost of a
+    // sudden burst of speed (a supernova) at the risk of bodies tunnelling.
+    int maxSubsteps = 0;
+    
+    // Optional passes of the step loop, as bits of activeStepFeatures()
+    enum StepFeature : unsigned {
+        StepAirDrag = 1u << 0,
+        StepTrails = 1u << 1,
+        StepOrbits = 1u << 2,
+        StepForceFields = 1u << 3,
+    };
+    static constexpr unsigned StepFeatureCount = 1u << 4;
+    
 private:
+    // Compile-time feature set for stepImpl; false strips the pass entirely
+    template <unsigned Mask>
+    struct StepFeatures {
+        static constexpr bool airDrag = (Mask & StepAirDrag) != 0;
+        static constexpr bool trails = (Mask & StepTrails) != 0;
+        static constexpr bool orbits = (Mask & StepOrbits) != 0;
+        static constexpr bool forceFields = (Mask & StepForceFields) != 0;
+    };
+    using StepFn = void (PhysicsWorld::*)(float);
+    template <class Features> void stepImpl(float dt);
+    template <size_t... Masks>
+    static std::array<StepFn, sizeof...(Masks)> makeStepTable(std::index_sequence<Masks...>);
+    
+    // Transient buffers of one step (grid binning, absorptions, debris);
+    // reset at the start of every step
+    StepArena stepArena;
+    
+    // Contacts of the current substep for the sleep islands: index pairs of
+    // touching movable bodies, and bodies held by a static or sleeping one
+    std::vector<uint32_t> sleepContacts;
+    std::vector<uint8_t> sleepSupported;
+    bool trackSleepContacts = false;
+    std::vector<uint32_t> islandParent;
+    std::vector<float> islandTime;
+    std::vector<uint8_t> islandSupported;
+    std::vector<uint32_t> islandLabel;
+    // Islands of woken sleepers, whose other members wake at the end of the substep
+    std::vector<uint32_t> wokenIslands;
+    uint32_t sleepIslandCount = 0;
+    void wakeBody(PhysicsObject& obj);
+    void wakeIslands();
+    // Compares the gravity pass's pull on each sleeper with the one it fell
+    // asleep under, then takes the velocity back off the ones still asleep
+    void checkSleeperPull();
+    // Gravity and walls the sleeping bodies came to rest under
+    float sleepGravity = 0.0f;
+    std::array<float, 4> sleepWalls = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    bool sleepOpen = false;
+    void checkSleepEnvironment();
+    void updateSleep(float dt);
+    
+    // Neighbour lists and the positions and radii they were built at
+    std::vector<NeighbourPair> neighbours;
+    std::vector<Real> neighbourX, neighbourY;
+    std::vector<float> neighbourRadius;
+    bool neighboursValid = false;
+    bool neighboursOpen = false;
+    float neighboursSkinSetting = 0.0f;  // neighbourSkin at the build
+    float neighboursSkin = 0.0f;         // after the cap
+    bool neighboursStale() const;
+    // Calls fn(i, j), i < j, for every pair in the same or adjacent grid cells
+    template <class Fn> void forEachCandidatePair(Fn fn) const;
+
+    // New index of each object before the last reorder
+    std::vector<uint32_t> reorderRemap;
+    // Morton code of every object, keeping the top `bits` bits of each axis
+    void mortonKeys(Span<uint32_t> keys, int bits) const;
+
+    // Scratch buffers for the batched force-field kernels
+    std::vector<size_t> fieldCandidates;
+    std::vector<float> fieldX, fieldY, fieldVX, fieldVY;
+    
+    // State of the world when the spatial grid was last built
+    bool gridBuilt = false;
+    bool gridOpen = false;
+    uint64_t gridRevision = ~0ull;
+    size_t gridObjectCount = 0;
+    float gridMaxExtent = 0.0f;
+    std::array<float, 4> gridWalls = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    int gridShape[2] = {0, 0};
+    std::vector<Real> gridX, gridY;  // positions binned by the last build
+    // How far any object has moved since the last build, if the grid still
+    // has the same objects and layout and they all moved under half a cell;
+    // otherwise -1. Queries widened by it find everything the current
+    // positions would, so the grid can be reused instead of rebuilt.
+    float gridDrift() const;
+    // queryRadius over cells widened by slack, testing current positions against r
+    void queryRadiusWithin(float x, float y, float r, float slack, std::vector<size_t>& out) const;
+    
+    BakedFieldGrid bakedFields;
+    bool forceFieldsDirty = true;
+    size_t bakedFieldCount = 0;
+    bool bakedFast = false;  // fastMath at the last bake
+    void bakeForceFieldGrid();
+    void resolveCollision(size_t i, size_t j);
+    template <class Policy, bool Fast> void applyPairwiseGravity();
+    void applyFarField();
+    void resolveGhostCollisions();
+    // Queues an event about objects[a] and other (objects[b], or a body held
+    // elsewhere with b = PhysicsEvent::none); callers test events.wants() first
+    void emitEvent(EventType type, size_t a, const PhysicsObject* other, size_t b, float value);
+    SpatialHashGrid ghostGrid;
+    // Moves everything but the objects by (-dx, -dy) in local coordinates
+    void shiftFrameState(Real dx, Real dy);
+    // Streams handed out since the last reseed; saved by history so a rewind
+    // replays the same debris
+    uint64_t randomStreams = 0;
+    // Sum of term(i) over [0, count) on the pool, see deterministic
+    template <class Term>
+    double parallelSum(size_t count, size_t block, Term term) const;
+    friend class SimulationHistory;
+    static void applyFieldKernel(const ForceField& field, size_t n, const float* xs, const float* ys,
+                                 float* vxs, float* vys, bool fast);
+
     // NEW: Helper for relativistic time dilation
     float getTimeDilation(const PhysicsObject& obj) const;
     
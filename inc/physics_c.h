@@ -0,0 +1,177 @@
+#ifndef PHYSICS_C_H
+#define PHYSICS_C_H
+
+/* C interface to PhysicsWorld for embedding the engine without the viewer
+ * (the physics_c library, which needs neither OpenGL, GLFW nor ImGui).
+ *
+ * Bodies are read in place: phys_get_view() returns pointers into the
+ * world's own object array plus a stride, so reading a million bodies
+ * copies nothing. A view stays valid until the next call that changes the
+ * world's objects (phys_step, phys_add_bodies, phys_clear); setting
+ * parameters and force fields leaves it alone. With PHYS_PARAM_REORDER on,
+ * a step may also permute the bodies, so indices are only stable within
+ * one view.
+ *
+ * Calls on one world are not thread-safe; separate worlds are independent.
+ * Functions returning int give 1 on success and 0 on a bad argument. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(PHYSICS_C_BUILD)
+#define PHYS_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define PHYS_API __declspec(dllimport)
+#else
+#define PHYS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a struct layout or an existing function changes */
+#define PHYS_ABI_VERSION 1
+
+typedef struct phys_world phys_world;
+
+/* Object types, numbered as the engine's ObjectType */
+enum {
+    PHYS_TYPE_NORMAL = 0,
+    PHYS_TYPE_MERGED = 1,
+    PHYS_TYPE_BLACK_HOLE = 2,
+    PHYS_TYPE_STAR = 3,
+    PHYS_TYPE_PLANET = 4,
+    PHYS_TYPE_ASTEROID = 5,
+    PHYS_TYPE_COMET = 6,
+    PHYS_TYPE_NEUTRON_STAR = 7,
+    PHYS_TYPE_WHITE_DWARF = 8,
+    PHYS_TYPE_GAS_GIANT = 9,
+    PHYS_TYPE_ROCKY_PLANET = 10
+};
+
+/* A body to add. Colour and the type's other properties (luminosity, event
+ * horizon, ...) are filled in as the file importers do; temperature <= 0
+ * keeps the type's default. */
+typedef struct phys_body {
+    double x, y;
+    double vx, vy;
+    float radius;
+    float mass;
+    float temperature;
+    int32_t type;       /* PHYS_TYPE_*; unknown values add a normal body */
+    int32_t is_static;
+} phys_body;
+
+/* Read-only view of every body. Body i's field f is at
+ * (const char*)view.f + i * view.stride. x, y, vx and vy are float when
+ * real_bytes is 4 and double when it is 8 (the build's precision); positions
+ * are relative to (origin_x, origin_y). All pointers are null when count
+ * is 0. */
+typedef struct phys_view {
+    size_t count;
+    size_t stride;          /* bytes between consecutive bodies */
+    int32_t real_bytes;
+    const void* x;
+    const void* y;
+    const void* vx;
+    const void* vy;
+    const float* mass;
+    const float* radius;
+    const int32_t* type;    /* PHYS_TYPE_* */
+    double origin_x, origin_y;
+    uint64_t step;          /* steps taken when the view was made */
+    uint64_t revision;      /* changes whenever the bodies do */
+} phys_view;
+
+/* Scalar settings of the world; see PhysicsWorld for what each does.
+ * Booleans read back as 0 or 1. */
+typedef enum phys_param {
+    PHYS_PARAM_GRAVITY = 0,         /* uniform downward pull */
+    PHYS_PARAM_G = 1,               /* body-body gravitational constant */
+    PHYS_PARAM_RESTITUTION = 2,
+    PHYS_PARAM_AIR_DRAG = 3,
+    PHYS_PARAM_GRAVITY_THETA = 4,   /* Barnes-Hut opening angle, 0 = exact */
+    PHYS_PARAM_LEFT = 5,            /* walls */
+    PHYS_PARAM_RIGHT = 6,
+    PHYS_PARAM_BOTTOM = 7,
+    PHYS_PARAM_TOP = 8,
+    PHYS_PARAM_OPEN_BOUNDARY = 9,
+    PHYS_PARAM_MAX_SUBSTEPS = 10,
+    PHYS_PARAM_ALLOW_SLEEPING = 11,
+    /* 12 is reserved (was a relativistic flag with no effect) */
+    PHYS_PARAM_DETERMINISTIC = 13,
+    PHYS_PARAM_FAST_MATH = 14,
+    PHYS_PARAM_REORDER = 15,        /* Morton reordering of the bodies */
+    PHYS_PARAM_NEIGHBOUR_SKIN = 16,
+    PHYS_PARAM_HASH_CELL_SIZE = 17, /* open-boundary collision grid */
+    PHYS_PARAM_GRID_ROWS = 18,      /* walled collision grid */
+    PHYS_PARAM_GRID_COLS = 19
+} phys_param;
+
+/* Force field kinds, numbered as ForceField::Type */
+enum {
+    PHYS_FIELD_RADIAL = 0,
+    PHYS_FIELD_DIRECTIONAL = 1,
+    PHYS_FIELD_VORTEX = 2,
+    PHYS_FIELD_CUSTOM = 3
+};
+
+/* Called once per substep with the n moving bodies inside a custom field's
+ * radius; velocities written to vx and vy are stored back */
+typedef void (*phys_field_fn)(void* user, const float* x, const float* y,
+                              float* vx, float* vy, size_t n);
+
+typedef struct phys_force_field {
+    int32_t type;           /* PHYS_FIELD_* */
+    float x, y;
+    float strength;
+    float radius;
+    float angle;            /* directional fields */
+    int32_t active;
+    phys_field_fn fn;       /* PHYS_FIELD_CUSTOM only */
+    void* user;
+} phys_force_field;
+
+PHYS_API int phys_abi_version(void);
+/* 4 or 8: the width of positions and velocities in this build */
+PHYS_API int phys_real_bytes(void);
+
+/* threads = 0 shares the process-wide pool; otherwise the world gets a pool
+ * of its own with that many threads (1 runs everything on the caller). */
+PHYS_API phys_world* phys_create(size_t threads);
+PHYS_API void phys_destroy(phys_world* world);
+
+/* Appends count bodies. With reject_overlaps, bodies overlapping one
+ * already in the world (or earlier in the batch) are dropped; without, the
+ * batch is written straight into the world in parallel. Returns how many
+ * were added. */
+PHYS_API size_t phys_add_bodies(phys_world* world, const phys_body* bodies, size_t count,
+                                int reject_overlaps);
+/* Room for count bodies, so adding up to it does not reallocate */
+PHYS_API void phys_reserve(phys_world* world, size_t count);
+/* Removes every body and resets the collision statistics */
+PHYS_API void phys_clear(phys_world* world);
+PHYS_API size_t phys_body_count(const phys_world* world);
+
+PHYS_API void phys_step(phys_world* world, float dt);
+PHYS_API uint64_t phys_state_hash(const phys_world* world);
+PHYS_API void phys_reseed(phys_world* world, uint64_t seed);
+
+PHYS_API int phys_set_param(phys_world* world, phys_param param, double value);
+PHYS_API int phys_get_param(const phys_world* world, phys_param param, double* value);
+
+/* Returns the new field's index, or -1 for an unknown type or a custom
+ * field without fn */
+PHYS_API int phys_add_force_field(phys_world* world, const phys_force_field* field);
+PHYS_API int phys_remove_force_field(phys_world* world, size_t index);
+PHYS_API int phys_set_force_field_active(phys_world* world, size_t index, int active);
+PHYS_API void phys_clear_force_fields(phys_world* world);
+
+PHYS_API int phys_get_view(const phys_world* world, phys_view* view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
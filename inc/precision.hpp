@@ -0,0 +1,31 @@
+#pragma once
+
+// Scalar policies for the simulation. Position is the type particle
+// positions and velocities are stored and integrated in; Accum is the type
+// per-pair force terms are evaluated in before being added to a velocity.
+template <class PositionT, class AccumT>
+struct PrecisionPolicy {
+    using Position = PositionT;
+    using Accum = AccumT;
+};
+
+using SinglePrecision = PrecisionPolicy<float, float>;
+using DoublePrecision = PrecisionPolicy<double, double>;
+// Double state so long runs and far-out bodies do not drift, float force math
+using MixedPrecision = PrecisionPolicy<double, float>;
+
+// Build-time choice (CMake PHYSICS_PRECISION=single|double|mixed)
+#if defined(PHYSICS_PRECISION_DOUBLE)
+using Precision = DoublePrecision;
+#elif defined(PHYSICS_PRECISION_MIXED)
+using Precision = MixedPrecision;
+#else
+using Precision = SinglePrecision;
+#endif
+
+// Scalar type of Particle::x, y, vx, vy, and of gravity accumulation
+using Real = Precision::Position;
+using Accum = Precision::Accum;
+
+template <class T>
+constexpr T gravitationalConstant() { return T(0.01); }
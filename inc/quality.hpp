@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+
+// Values of the knobs the quality controller trades for speed
+struct QualitySettings {
+    float treeTheta = 0.0f;        // PhysicsWorld::gravityTheta
+    int substepCap = 0;            // PhysicsWorld::maxSubsteps, 0 = no cap
+    int fieldResolution = 20;      // GridRenderer samples per axis
+    int diagnosticsInterval = 1;   // frames between diagnostics refreshes
+    uint32_t trailDecimation = 1;  // TrailPool::decimation
+};
+
+// Holds step() and the rest of the frame under their budgets by degrading
+// knobs one level at a time, within limits, and restoring them (most
+// recently degraded first) once there has been headroom for a while. Step
+// time drives the tree angle, substep cap and trail decimation; the view
+// (field arrows, diagnostics, drawing) drives field resolution and the
+// diagnostics refresh. A single step over twice its budget, such as a
+// supernova or galaxy spawn, counts at once rather than being averaged in.
+class QualityController {
+public:
+    enum Knob { TreeTheta, SubstepCap, TrailDecimation, FieldResolution, Diagnostics, KnobCount };
+    static constexpr int maxLevel = 4;
+
+    bool enabled = false;
+    float stepBudgetMs = 10.0f;
+    float viewBudgetMs = 6.0f;
+    // Worst value each knob may be degraded to
+    QualitySettings limits = {1.0f, 2, 8, 30, 8};
+
+    // Once per frame with the user's settings and the measured times;
+    // stepMs < 0 when no step ran (paused)
+    void update(const QualitySettings& preferred, double stepMs, double viewMs);
+    // preferred with the current degradation applied
+    QualitySettings apply(const QualitySettings& preferred) const;
+    void reset();
+
+    int level(Knob knob) const { return levels[knob]; }
+    // Why the knob is degraded; empty at level 0
+    const char* reason(Knob knob) const { return reasons[knob]; }
+    static const char* knobName(Knob knob);
+    double stepAverageMs() const { return stepAverage; }
+    double viewAverageMs() const { return viewAverage; }
+
+private:
+    int levels[KnobCount] = {};
+    char reasons[KnobCount][64] = {};
+    // Degradations in the order they were made, undone from the back
+    Knob degraded[KnobCount * maxLevel];
+    int degradedCount = 0;
+
+    double stepAverage = 0.0, viewAverage = 0.0;
+    int stepCooldown = 0, viewCooldown = 0;
+    int stepCalm = 0, viewCalm = 0;
+
+    void control(const QualitySettings& preferred, const Knob* knobs, int count, double ms, float budget,
+                 const char* what, double& average, int& cooldown, int& calm);
+    bool degrade(const QualitySettings& preferred, Knob knob);
+};
@@ -3,5 +3,8 @@
 #include <GLFW/glfw3.h>
 #include "physics.hpp"
 #include "grid.hpp"
+#include "particle_renderer.hpp"
+#include "line_batch.hpp"
+#include "camera.hpp"
 
-void renderLoop(GLFWwindow* window, GLuint gridProgram, GLuint gridVAO, int gridVertexCount, GLuint axisProgram, GLuint axisVAO, int axisVertexCount, GridRenderer& gridRenderer, PhysicsWorld& world, GLuint pointProgram);
+void renderLoop(GLFWwindow* window, GLuint gridProgram, GLuint gridVAO, int gridVertexCount, GLuint axisProgram, GLuint axisVAO, int axisVertexCount, GridRenderer& gridRenderer, ParticleRenderer& particleRenderer, LineBatch& lines, const Camera2D& camera, PhysicsWorld& world);
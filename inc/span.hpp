@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Minimal non-owning view over contiguous storage (std::span is C++20)
+template <typename T>
+struct Span {
+    T* ptr = nullptr;
+    size_t len = 0;
+
+    Span() = default;
+    Span(T* p, size_t n) : ptr(p), len(n) {}
+    template <typename U>
+    Span(std::vector<U>& v) : ptr(v.data()), len(v.size()) {}
+    template <typename U>
+    Span(const std::vector<U>& v) : ptr(v.data()), len(v.size()) {}
+
+    T* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    T& operator[](size_t i) const { return ptr[i]; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + len; }
+};
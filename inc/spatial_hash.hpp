@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include "particle.hpp"
+
+// Sparse uniform grid over an unbounded plane. Occupied cells live in an
+// open-addressed table keyed by integer cell coordinates; objects in a cell
+// are chained through next[], so memory scales with the number of objects
+// and occupied cells, never with the area they span.
+class SpatialHashGrid {
+public:
+    static constexpr uint32_t npos = 0xFFFFFFFFu;
+
+    struct Cell {
+        int32_t cx, cy;
+        uint32_t head; // first object in the cell, chained through next()
+    };
+
+    void build(const std::vector<Particle>& objects, float cellSize);
+    // Adds one object after build(); index must be objects.size() at the time
+    void insert(size_t index, float x, float y);
+    void clear();
+
+    float cellSize() const { return size; }
+    int32_t cellCoord(float v) const {
+        // Clamped so runaway or non-finite positions still land in a valid cell
+        float c = std::floor(v * invSize);
+        if (!(c > -1e9f)) return -1000000000;
+        if (c > 1e9f) return 1000000000;
+        return static_cast<int32_t>(c);
+    }
+
+    // Occupied cells in insertion order, and the chain through each one
+    const std::vector<Cell>& cells() const { return occupied; }
+    uint32_t next(uint32_t index) const { return chain[index]; }
+    // Head of the chain for cell (cx, cy), or npos if it is empty
+    uint32_t find(int32_t cx, int32_t cy) const;
+
+    // Calls fn(index) for every object in the cells overlapping the rectangle
+    template <class Fn>
+    void forEachInRect(float minX, float minY, float maxX, float maxY, Fn fn) const {
+        if (occupied.empty()) return;
+        int32_t c0 = cellCoord(minX), c1 = cellCoord(maxX);
+        int32_t r0 = cellCoord(minY), r1 = cellCoord(maxY);
+        // A huge rectangle over few cells: scan the occupied list instead
+        if (static_cast<double>(c1 - c0 + 1) * (r1 - r0 + 1) > static_cast<double>(occupied.size())) {
+            for (const Cell& cell : occupied) {
+                if (cell.cx < c0 || cell.cx > c1 || cell.cy < r0 || cell.cy > r1) continue;
+                for (uint32_t i = cell.head; i != npos; i = chain[i]) fn(static_cast<size_t>(i));
+            }
+            return;
+        }
+        for (int32_t cy = r0; cy <= r1; ++cy) {
+            for (int32_t cx = c0; cx <= c1; ++cx) {
+                for (uint32_t i = find(cx, cy); i != npos; i = chain[i]) fn(static_cast<size_t>(i));
+            }
+        }
+    }
+
+    size_t memoryUsage() const;
+
+private:
+    float size = 0.1f;
+    float invSize = 10.0f;
+    std::vector<uint32_t> slots;  // power-of-two table of indices into occupied
+    std::vector<Cell> occupied;
+    std::vector<uint32_t> chain;  // per object: next object in the same cell
+
+    static uint32_t hash(int32_t cx, int32_t cy) {
+        uint64_t k = (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        return static_cast<uint32_t>(k);
+    }
+    uint32_t& cellHead(int32_t cx, int32_t cy);
+    void rehash(size_t slotCount);
+};
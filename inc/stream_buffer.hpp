@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <GL/glew.h>
+
+// Vertex buffer rewritten every frame. When GL_ARB_buffer_storage is
+// available it is persistently mapped and split into regions fenced
+// round-robin; otherwise (e.g. older Mesa software contexts) writes go to a
+// staging copy that is uploaded into an orphaned buffer.
+//
+// Per upload: p = map(bytes); write; offset = unmap(); draw using offset
+// into buffer(); fence().
+class StreamBuffer {
+public:
+    void init();
+    void destroy();
+
+    void* map(size_t bytes);
+    size_t unmap();   // byte offset of the data within buffer()
+    void fence();
+
+    GLuint buffer() const { return vbo; }
+    bool isPersistent() const { return persistent; }
+
+private:
+    static constexpr int kRegions = 3;
+
+    GLuint vbo = 0;
+    bool persistent = false;
+    size_t regionBytes = 0;
+    size_t pendingBytes = 0;
+    int region = 0;
+    unsigned char* mapped = nullptr;
+    GLsync fences[kRegions] = {};
+    std::vector<unsigned char> staging; // fallback path only
+
+    void reserve(size_t bytes);
+    void waitAll();
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed set of worker threads that split index ranges between them. The
+// calling thread works too and parallelFor() blocks until every chunk is done.
+// Nested calls from inside a running chunk execute inline.
+class ThreadPool {
+public:
+    using RangeFn = std::function<void(size_t begin, size_t end)>;
+
+    // threads = 0 uses the hardware concurrency; pinned keeps each worker on
+    // its own core (Linux), so long-running jobs keep their caches warm
+    explicit ThreadPool(size_t threads = 0, bool pinned = false);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads taking part in parallelFor, including the caller
+    size_t size() const { return workers.size() + 1; }
+
+    // Run fn over [0, count) in chunks of at least `grain` indices
+    void parallelFor(size_t count, const RangeFn& fn, size_t grain = 1);
+
+    // Process-wide pool shared by the engine and renderer
+    static ThreadPool& shared();
+
+    // 1..size()-1 on this pool's workers, 0 on any other thread (the caller
+    // of parallelFor); for per-thread buffers indexed by slot
+    size_t workerIndex() const;
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex submitMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    // Current job
+    const RangeFn* jobFn = nullptr;
+    size_t jobCount = 0;
+    size_t jobChunk = 1;
+    std::atomic<size_t> jobNext{0};
+    size_t jobPending = 0;
+
+    void workerLoop(size_t index);
+    void runChunks();
+};
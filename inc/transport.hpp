@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Message passing between the ranks of a decomposed run. Every call is
+// collective: all ranks make the same sequence of exchange() calls.
+class Transport {
+public:
+    using Buffer = std::vector<uint8_t>;
+
+    virtual ~Transport() = default;
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+
+    // All-to-all: outgoing[r] is delivered to rank r, and incoming[r] is
+    // what rank r sent here (the rank's own slot included). Returns false on
+    // every rank if any message did not fit or a peer timed out.
+    virtual bool exchange(const std::vector<Buffer>& outgoing, std::vector<Buffer>& incoming) = 0;
+
+    // Sends the same bytes to every rank
+    bool allGather(const Buffer& mine, std::vector<Buffer>& all) {
+        return exchange(std::vector<Buffer>(size(), mine), all);
+    }
+};
+
+// Transport over one POSIX shared-memory segment holding a mailbox per
+// (sender, receiver) pair, double-buffered so a single barrier per exchange
+// is enough: a rank can only start exchange k + 1 once every rank has
+// finished reading exchange k - 1, which used the other set.
+class ShmTransport : public Transport {
+public:
+    // Creates the segment (failing if `name` exists) and attaches as rank 0.
+    // capacity bounds one message between one pair of ranks.
+    static std::unique_ptr<ShmTransport> create(const char* name, int ranks, size_t capacity);
+    // Attaches to a segment made by create(); call once per other rank
+    static std::unique_ptr<ShmTransport> attach(const char* name, int rank);
+    // Removes the name; mapped segments stay valid until detached
+    static void unlink(const char* name);
+
+    ~ShmTransport() override;
+
+    int rank() const override { return me; }
+    int size() const override { return ranks; }
+    bool exchange(const std::vector<Buffer>& outgoing, std::vector<Buffer>& incoming) override;
+
+    // A rank waiting longer than this on a barrier gives up
+    double timeoutSeconds = 60.0;
+
+private:
+    struct Header;
+    ShmTransport() = default;
+
+    Header* header = nullptr;
+    unsigned char* base = nullptr;
+    size_t mappedBytes = 0;
+    int me = 0;
+    int ranks = 1;
+    size_t capacity = 0;
+    uint64_t exchanges = 0;
+
+    unsigned char* mailbox(uint64_t set, int from, int to) const;
+    bool barrier();
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <GLFW/glfw3.h>
+#include "quality.hpp"
 
 struct UIState {
     float gravity = 0.0f;
@@ -10,7 +11,21 @@ struct UIState {
     bool showLabels = true;
     bool showField = true;
     bool showAxes = true;
+    bool showSleeping = true;   // tint sleeping bodies
     bool paused = false;
+    int fieldResolution = 20;   // gravity field samples per axis
+    float treeTheta = 0.0f;     // Barnes-Hut opening angle, 0 = exact
+    int substepCap = 0;         // 0 = no cap
+    int trailDecimation = 1;
+    int diagnosticsInterval = 1; // frames between diagnostics refreshes
+
+    // The settings above are what the user asked for; the controller may run
+    // the frame with degraded ones (applied)
+    QualityController quality;
+    QualitySettings applied;
+    QualitySettings preferredQuality() const {
+        return {treeTheta, substepCap, fieldResolution, diagnosticsInterval, static_cast<uint32_t>(trailDecimation)};
+    }
 };
 
 // Now takes PhysicsWorld* for diagnostics display
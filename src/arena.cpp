@@ -0,0 +1,57 @@
+#include "arena.hpp"
+#include <algorithm>
+
+void* StepArena::bump(size_t bytes, size_t align) {
+    if (!blocks.empty()) {
+        size_t start = (offset + align - 1) & ~(align - 1);
+        if (start + bytes <= blocks[current].size) {
+            offset = start + bytes;
+            stepPeak = std::max(stepPeak, before + offset);
+            peak = std::max(peak, stepPeak);
+            return blocks[current].data.get() + start;
+        }
+        // Later blocks are left over from before a Scope rewound; reuse one
+        // that fits, otherwise grow
+        while (current + 1 < blocks.size()) {
+            before += blocks[current].size;
+            ++current;
+            if (bytes + align <= blocks[current].size) {
+                offset = 0;
+                return bump(bytes, align);
+            }
+        }
+        before += blocks[current].size;
+    }
+    size_t size = std::max(bytes + align, minBlock);
+    if (!blocks.empty()) size = std::max(size, 2 * blocks.back().size);
+    blocks.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+    current = blocks.size() - 1;
+    offset = 0;
+    return bump(bytes, align);
+}
+
+void StepArena::reset() {
+    if (blocks.size() > 1) {
+        size_t total = capacity();
+        blocks.clear();
+        blocks.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[total]), total});
+    }
+    current = 0;
+    offset = 0;
+    before = 0;
+    stepPeak = 0;
+}
+
+void StepArena::release() {
+    blocks.clear();
+    current = 0;
+    offset = 0;
+    before = 0;
+    stepPeak = 0;
+}
+
+size_t StepArena::capacity() const {
+    size_t total = 0;
+    for (const auto& b : blocks) total += b.size;
+    return total;
+}
@@ -0,0 +1,181 @@
+#include "batch_runner.hpp"
+#include "physics.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+BatchRunner::BatchRunner(ThreadPool* pool) : pool(pool ? pool : &ThreadPool::shared()) {}
+
+BatchRunner::~BatchRunner() = default;
+
+size_t BatchRunner::add(BatchJob job) {
+    jobs.push_back(std::move(job));
+    return jobs.size() - 1;
+}
+
+void BatchRunner::run() {
+    size_t first = finished.size();
+    size_t count = jobs.size() - first;
+    if (count == 0) return;
+    finished.resize(jobs.size());
+    std::vector<Slot> slots(count);
+
+    // Build every world first so its size is known before scheduling
+    pool->parallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            Slot& slot = slots[k];
+            const BatchJob& job = jobs[first + k];
+            slot.world.reset(new PhysicsWorld());
+            PhysicsWorld& world = *slot.world;
+            world.threadPool = pool;
+            world.history.enabled = false;
+            if (job.setup) job.setup(world);
+            slot.startEnergy = world.totalKineticEnergy() + world.totalPotentialEnergy();
+            double n = static_cast<double>(world.objects.size()) + 1.0;
+            double perStep = world.gravityTheta > 0.0f ? 8.0 * n * std::log2(n + 1.0) : n * n;
+            slot.cost = (perStep + n) * static_cast<double>(job.maxSteps);
+        }
+    });
+
+    // Most expensive first; worlds below a per-task share are packed
+    // together until the pack reaches it
+    std::vector<size_t> order(count);
+    for (size_t k = 0; k < count; ++k) order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return slots[a].cost > slots[b].cost; });
+    double total = 0.0;
+    for (const auto& slot : slots) total += slot.cost;
+    double target = total / static_cast<double>(pool->size() * 4);
+    std::vector<std::vector<size_t>> packs;
+    double packCost = target;
+    for (size_t k : order) {
+        if (slots[k].cost >= target || packCost >= target) {
+            packs.emplace_back();
+            packCost = 0.0;
+        }
+        packs.back().push_back(k);
+        packCost += slots[k].cost;
+    }
+
+    pool->parallelFor(packs.size(), [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            for (size_t k : packs[p]) runJob(first + k, slots[k]);
+        }
+    });
+}
+
+void BatchRunner::runJob(size_t index, Slot& slot) {
+    using Clock = std::chrono::steady_clock;
+    const BatchJob& job = jobs[index];
+    PhysicsWorld& world = *slot.world;
+    BatchResult& out = finished[index];
+    uint32_t checkEvery = std::max<uint32_t>(job.checkEvery, 1);
+
+    auto start = Clock::now();
+    double lastKinetic = world.totalKineticEnergy();
+    uint64_t steps = 0;
+    out.stop = BatchStop::Steps;
+    while (steps < job.maxSteps) {
+        world.step(job.dt);
+        ++steps;
+        if (steps % checkEvery != 0) continue;
+        if (job.maxWallSeconds > 0.0 &&
+            std::chrono::duration<double>(Clock::now() - start).count() >= job.maxWallSeconds) {
+            out.stop = BatchStop::WallClock;
+            break;
+        }
+        if (job.settleTolerance > 0.0f) {
+            double kinetic = world.totalKineticEnergy();
+            bool settled = std::fabs(kinetic - lastKinetic) <= job.settleTolerance * std::max(lastKinetic, 1e-12);
+            lastKinetic = kinetic;
+            if (settled) {
+                out.stop = BatchStop::Settled;
+                break;
+            }
+        }
+        if (job.converged && job.converged(world)) {
+            out.stop = BatchStop::Converged;
+            break;
+        }
+    }
+
+    out.steps = steps;
+    out.simTime = static_cast<double>(steps) * job.dt;
+    out.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    out.objects = world.objects.size();
+    out.kinetic = world.totalKineticEnergy();
+    out.potential = world.totalPotentialEnergy();
+    double energy = out.kinetic + out.potential;
+    out.energyDrift = slot.startEnergy != 0.0 ? (energy - slot.startEnergy) / std::fabs(slot.startEnergy) : 0.0;
+    float px, py;
+    world.totalMomentum(px, py);
+    out.momentum = std::sqrt(static_cast<double>(px) * px + static_cast<double>(py) * py);
+    out.angularMomentum = world.totalAngularMomentum();
+    out.collisions = world.stats.totalCollisions;
+    out.absorbed = world.stats.objectsAbsorbed;
+    out.stateHash = world.stateHash();
+    // Only the diagnostics are kept; free the world before the next one runs
+    slot.world.reset();
+}
+
+bool BatchRunner::writeColumnar(const char* path) const {
+    struct Column {
+        const char* name;
+        uint32_t type;
+        std::function<uint64_t(size_t)> bits;
+    };
+    auto f64 = [](double v) {
+        uint64_t b;
+        std::memcpy(&b, &v, 8);
+        return b;
+    };
+    const auto& r = finished;
+    std::vector<Column> columns = {
+        {"job", 1, [](size_t i) { return static_cast<uint64_t>(i); }},
+        {"stop", 1, [&](size_t i) { return static_cast<uint64_t>(r[i].stop); }},
+        {"steps", 1, [&](size_t i) { return r[i].steps; }},
+        {"sim_time", 0, [&](size_t i) { return f64(r[i].simTime); }},
+        {"wall_seconds", 0, [&](size_t i) { return f64(r[i].wallSeconds); }},
+        {"objects", 1, [&](size_t i) { return r[i].objects; }},
+        {"kinetic", 0, [&](size_t i) { return f64(r[i].kinetic); }},
+        {"potential", 0, [&](size_t i) { return f64(r[i].potential); }},
+        {"energy_drift", 0, [&](size_t i) { return f64(r[i].energyDrift); }},
+        {"momentum", 0, [&](size_t i) { return f64(r[i].momentum); }},
+        {"angular_momentum", 0, [&](size_t i) { return f64(r[i].angularMomentum); }},
+        {"collisions", 1, [&](size_t i) { return r[i].collisions; }},
+        {"absorbed", 1, [&](size_t i) { return r[i].absorbed; }},
+        {"state_hash", 1, [&](size_t i) { return r[i].stateHash; }},
+    };
+    for (size_t p = 0; p < paramNames.size(); ++p) {
+        columns.push_back({paramNames[p].c_str(), 0, [&, p](size_t i) {
+            const auto& params = jobs[i].params;
+            return f64(p < params.size() ? params[p] : 0.0);
+        }});
+    }
+
+    FILE* f = std::fopen(path, "wb");
+    if (!f) return false;
+    BatchFileHeader header = {};
+    std::memcpy(header.magic, "PHBR", 4);
+    header.version = 1;
+    header.rows = r.size();
+    header.columns = static_cast<uint32_t>(columns.size());
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t offset = sizeof(header) + columns.size() * sizeof(BatchColumn);
+    for (const auto& column : columns) {
+        BatchColumn entry = {};
+        std::strncpy(entry.name, column.name, sizeof(entry.name) - 1);
+        entry.type = column.type;
+        entry.offset = offset;
+        ok = ok && std::fwrite(&entry, sizeof(entry), 1, f) == 1;
+        offset += r.size() * 8;
+    }
+    std::vector<uint64_t> values(r.size());
+    for (const auto& column : columns) {
+        for (size_t i = 0; i < r.size(); ++i) values[i] = column.bits(i);
+        ok = ok && (values.empty() || std::fwrite(values.data(), 8, values.size(), f) == values.size());
+    }
+    return std::fclose(f) == 0 && ok;
+}
@@ -0,0 +1,230 @@
+#include "benchmark.hpp"
+#include "batch_runner.hpp"
+#include "physics.hpp"
+#include "philox.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct PassTimes {
+    double grid = 0.0, collisions = 0.0, gravity = 0.0;
+};
+
+// Collisions rebuild the grid themselves, so their time includes it.
+// Best of repeats, so one page-fault-heavy first run does not count
+PassTimes timePasses(PhysicsWorld& world, int repeats) {
+    PassTimes best;
+    for (int r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        world.updateSpatialGrid();
+        double grid = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        world.handleCollisions();
+        double collisions = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        world.applyGravityForces();
+        double gravity = millisecondsSince(start);
+        if (r == 0 || grid < best.grid) best.grid = grid;
+        if (r == 0 || collisions < best.collisions) best.collisions = collisions;
+        if (r == 0 || gravity < best.gravity) best.gravity = gravity;
+    }
+    return best;
+}
+
+} // namespace
+
+int runReorderBenchmark(size_t count, int repeats) {
+    if (count < 2 || repeats < 1) {
+        std::fprintf(stderr, "Benchmark needs at least 2 bodies and 1 repeat\n");
+        return 1;
+    }
+    PhysicsWorld world;
+    world.history.enabled = false;
+    world.allowSleeping = false;
+    world.openBoundary = true;
+    world.useNeighbourLists = false;   // time the grid sweep itself every repeat
+    world.gravityTheta = 0.8f;
+    world.G = 1e-6;
+
+    // Unit disc with a few bodies per hashed cell and no overlaps to speak of
+    const float spacing = std::sqrt(3.14159265f / static_cast<float>(count));
+    world.hashCellSize = 2.0f * spacing;
+    world.reserve(count);
+    Span<PhysicsObject> bodies = world.appendObjects(count);
+    Philox rng(world.seed);
+    for (size_t i = 0; i < count; ++i) {
+        Philox::Block u = rng(0, i);
+        float r = std::sqrt(Philox::uniform(u[0], 0.0f, 1.0f));
+        float angle = Philox::uniform(u[1], 0.0f, 6.2831853f);
+        auto& p = bodies[i];
+        p.x = r * std::cos(angle);
+        p.y = r * std::sin(angle);
+        p.vx = -0.3f * std::sin(angle);
+        p.vy = 0.3f * std::cos(angle);
+        p.radius = 0.25f * spacing;
+        p.mass = 1.0f;
+    }
+    // Fisher-Yates, so neighbours in space are scattered through memory
+    for (size_t i = count - 1; i > 0; --i) {
+        Philox::Block u = rng(1, i);
+        size_t j = ((static_cast<uint64_t>(u[0]) << 32) | u[1]) % (i + 1);
+        std::swap(world.objects[i], world.objects[j]);
+    }
+    world.invalidateNeighbours();
+
+    std::printf("%zu bodies, best of %d, tree theta %.2f\n", count, repeats, world.gravityTheta);
+    float disorder = world.localityDisorder();
+    PassTimes mixed = timePasses(world, repeats);
+
+    auto start = std::chrono::steady_clock::now();
+    world.reorderForLocality();
+    double reorder = millisecondsSince(start);
+    float sortedDisorder = world.localityDisorder();
+    PassTimes sorted = timePasses(world, repeats);
+
+    std::printf("%-10s %10s %12s %12s %10s\n", "order", "disorder", "grid ms", "collide ms", "gravity ms");
+    std::printf("%-10s %10.3f %12.2f %12.2f %10.1f\n", "shuffled", disorder, mixed.grid, mixed.collisions,
+                mixed.gravity);
+    std::printf("%-10s %10.3f %12.2f %12.2f %10.1f\n", "morton", sortedDisorder, sorted.grid, sorted.collisions,
+                sorted.gravity);
+    std::printf("reorder took %.1f ms; speed-up grid x%.2f  collisions x%.2f  gravity x%.2f\n", reorder,
+                mixed.grid / sorted.grid, mixed.collisions / sorted.collisions, mixed.gravity / sorted.gravity);
+    return 0;
+}
+
+int runReplayCheck(size_t count, int steps) {
+    if (count < 2 || steps < 4) {
+        std::fprintf(stderr, "Replay check needs at least 2 bodies and 4 steps\n");
+        return 1;
+    }
+    PhysicsWorld world;
+    world.allowSleeping = true;
+    world.gravity = -2.0f;
+    world.restitution = 0.3f;
+    world.G = 0.0;               // a pile on the floor, with nothing pulling it apart
+    world.gravityTheta = 1.0f;
+    world.history.memoryBudget = SIZE_MAX;   // the seek target must not be evicted
+    const float spacing = std::sqrt(1.0f / static_cast<float>(count));
+    world.reserve(count);
+    Span<PhysicsObject> bodies = world.appendObjects(count);
+    Philox rng(world.seed);
+    for (size_t i = 0; i < count; ++i) {
+        Philox::Block u = rng(0, i);
+        auto& p = bodies[i];
+        p.x = Philox::uniform(u[0], -0.9f, 0.9f);
+        p.y = Philox::uniform(u[1], -0.9f, 0.9f);
+        p.radius = 0.3f * spacing;
+        p.mass = 1.0f;
+    }
+
+    // The gravity change is part of the script, so it is made again on replay
+    const float dt = 1.0f / 60.0f;
+    auto advance = [&](int s) {
+        world.gravity = s < steps / 2 ? -2.0f : -1.0f;
+        world.step(dt);
+    };
+    const uint64_t first = world.stepCount;
+    std::vector<uint64_t> hashes;
+    size_t mostAsleep = 0;
+    for (int s = 0; s < steps; ++s) {
+        advance(s);
+        hashes.push_back(world.stateHash());
+        mostAsleep = std::max(mostAsleep, world.sleepingCount());
+    }
+
+    const int from = steps / 4;
+    if (!world.history.seek(first + from, world)) {
+        std::fprintf(stderr, "Step %d was not retained\n", from);
+        return 1;
+    }
+    if (world.stateHash() != hashes[from - 1]) {
+        std::fprintf(stderr, "Seek to step %d restored a different state\n", from);
+        return 1;
+    }
+    for (int s = from; s < steps; ++s) {
+        advance(s);
+        if (world.stateHash() != hashes[s]) {
+            std::fprintf(stderr, "Replay from step %d diverged at step %d\n", from, s + 1);
+            return 1;
+        }
+    }
+    std::printf("%zu bodies, up to %zu asleep: steps %d..%d replayed identically\n", count, mostAsleep,
+                from + 1, steps);
+    return 0;
+}
+
+int runFastMathCheck(int steps) {
+    if (steps < 1) {
+        std::fprintf(stderr, "Fast-math check needs at least 1 step\n");
+        return 1;
+    }
+    const size_t sizes[] = {300, 1000, 2000};
+    const float thetas[] = {0.0f, 0.7f};
+    BatchRunner runner;
+    runner.paramNames = {"bodies", "theta", "fast"};
+    for (size_t n : sizes) {
+        for (float theta : thetas) {
+            for (int fast = 0; fast < 2; ++fast) {
+                BatchJob job;
+                job.maxSteps = static_cast<uint64_t>(steps);
+                job.params = {static_cast<double>(n), theta, static_cast<double>(fast)};
+                job.setup = [n, theta, fast](PhysicsWorld& world) {
+                    world.allowSleeping = false;
+                    world.openBoundary = true;
+                    world.restitution = 1.0f;
+                    world.gravityTheta = theta;
+                    world.fastMath = fast != 0;
+                    // A slowly turning disc of total mass 3 whatever the count:
+                    // gravity bends the orbits without collapsing the disc,
+                    // whose close passes would turn any last-bit difference
+                    // into chaos
+                    Span<PhysicsObject> bodies = world.appendObjects(n);
+                    Philox rng(world.seed);
+                    const float meanMass = 3.0f / static_cast<float>(n);
+                    for (size_t i = 0; i < n; ++i) {
+                        Philox::Block u = rng(0, i);
+                        float angle = Philox::uniform(u[0], 0.0f, 6.2831853f);
+                        float r = Philox::uniform(u[1], 0.1f, 0.95f);
+                        auto& p = bodies[i];
+                        p.x = r * std::cos(angle);
+                        p.y = r * std::sin(angle);
+                        p.vx = -0.05f * std::sin(angle);
+                        p.vy = 0.05f * std::cos(angle);
+                        p.radius = 0.003f;
+                        p.mass = Philox::uniform(u[2], 0.5f, 1.5f) * meanMass;
+                    }
+                };
+                runner.add(std::move(job));
+            }
+        }
+    }
+    runner.run();
+
+    const auto& results = runner.results();
+    bool within = true;
+    std::printf("bound %.4f of |E0|, %d steps\n", PhysicsWorld::fastMathDriftBound, steps);
+    std::printf("%8s %6s %14s %14s %12s\n", "bodies", "theta", "precise drift", "fast drift", "difference");
+    for (size_t k = 0; k + 1 < results.size(); k += 2) {
+        const BatchResult& precise = results[k];
+        const BatchResult& fast = results[k + 1];
+        double diff = std::fabs(fast.energyDrift - precise.energyDrift);
+        within = within && diff <= PhysicsWorld::fastMathDriftBound;
+        std::printf("%8zu %6.2f %14.6f %14.6f %12.6f%s\n", sizes[k / 4], thetas[(k / 2) % 2], precise.energyDrift, fast.energyDrift, diff,
+                    diff <= PhysicsWorld::fastMathDriftBound ? "" : "  over");
+    }
+    if (!within) {
+        std::fprintf(stderr, "Fast-math energy drift exceeded the bound\n");
+        return 1;
+    }
+    return 0;
+}
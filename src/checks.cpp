@@ -0,0 +1,131 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "benchmark.hpp"
+#include "philox.hpp"
+#include "physics.hpp"
+
+// Every heap allocation of the process, engine included, for the
+// allocation check
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Steps a box of count bodies, some with components, under tree gravity, a
+// force field, trails and sleeping checks, with history recording into
+// a budget small enough that old segments are dropped. Once the history
+// is full and the buffers have grown, stepping must not allocate; returns
+// 1 if any of steps more steps does.
+static int runAllocationCheck(size_t count, int steps) {
+    PhysicsWorld world;
+    world.gravityTheta = 0.7f;
+    world.history.memoryBudget = 2u * 1024u * 1024u;
+    world.reserve(count);
+    Span<PhysicsObject> bodies = world.appendObjects(count);
+    Philox rng(world.seed);
+    for (size_t i = 0; i < count; ++i) {
+        Philox::Block u = rng(0, i);
+        auto& p = bodies[i];
+        p.x = Philox::uniform(u[0], -0.9f, 0.9f);
+        p.y = Philox::uniform(u[1], -0.9f, 0.9f);
+        p.vx = Philox::uniform(u[2], -0.5f, 0.5f);
+        p.vy = Philox::uniform(u[3], -0.5f, 0.5f);
+        p.radius = 0.005f;
+        p.mass = 0.01f;
+        if (i % 16 == 0) p.trailLength = 32;
+        if (i % 64 == 0) p.components.resize(3);
+    }
+    ForceField vortex;
+    vortex.type = ForceField::VORTEX;
+    vortex.x = 0.0f;
+    vortex.y = 0.0f;
+    vortex.strength = 0.5f;
+    vortex.radius = 0.5f;
+    world.addForceField(vortex);
+
+    // Until the budget has dropped a few segments and the contact lists
+    // have grown to what the gas needs
+    const float dt = 1.0f / 60.0f;
+    world.step(dt);
+    const uint64_t first = world.history.oldestStep();
+    int warmup = 1;
+    while (warmup < 600 || world.history.oldestStep() < first + 3 * world.history.keyframeInterval) {
+        world.step(dt);
+        ++warmup;
+    }
+    size_t before = allocationCount.load();
+    int allocatingSteps = 0;
+    for (int s = 0; s < steps; ++s) {
+        size_t stepBefore = allocationCount.load();
+        world.step(dt);
+        if (allocationCount.load() != stepBefore) ++allocatingSteps;
+    }
+    size_t allocations = allocationCount.load() - before;
+    std::printf("%zu bodies, history from step %llu after %d warm-up steps: %zu allocations in %d of %d steps\n",
+                count, static_cast<unsigned long long>(world.history.oldestStep()), warmup, allocations,
+                allocatingSteps, steps);
+    return allocations == 0 ? 0 : 1;
+}
+
+// Headless checks and benchmarks, run by ctest (see CMakeLists.txt):
+//   PhysicsChecks --check-replay [N] [--steps S]
+//   PhysicsChecks --check-fast-math [--steps S]
+//   PhysicsChecks --check-allocations [N] [--steps S]
+//   PhysicsChecks --bench-reorder [N] [--repeats R]
+int main(int argc, char** argv) {
+    const char* mode = argc > 1 ? argv[1] : "";
+    if (std::strcmp(mode, "--check-replay") == 0) {
+        size_t count = 2000;
+        int steps = 600;
+        for (int i = 2; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+                steps = std::atoi(argv[++i]);
+            } else {
+                count = std::strtoull(argv[i], nullptr, 10);
+            }
+        }
+        return runReplayCheck(count, steps);
+    }
+    if (std::strcmp(mode, "--check-fast-math") == 0) {
+        int steps = 300;
+        for (int i = 2; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) steps = std::atoi(argv[++i]);
+        }
+        return runFastMathCheck(steps);
+    }
+    if (std::strcmp(mode, "--check-allocations") == 0) {
+        size_t count = 1000;
+        int steps = 300;
+        for (int i = 2; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+                steps = std::atoi(argv[++i]);
+            } else {
+                count = std::strtoull(argv[i], nullptr, 10);
+            }
+        }
+        return runAllocationCheck(count, steps);
+    }
+    if (std::strcmp(mode, "--bench-reorder") == 0) {
+        size_t count = 1000000;
+        int repeats = 3;
+        for (int i = 2; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+                repeats = std::atoi(argv[++i]);
+            } else {
+                count = std::strtoull(argv[i], nullptr, 10);
+            }
+        }
+        return runReorderBenchmark(count, repeats);
+    }
+    std::fprintf(stderr, "Usage: %s --check-replay [N] [--steps S] | --check-fast-math [--steps S] | "
+                         "--check-allocations [N] [--steps S] | --bench-reorder [N] [--repeats R]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,500 @@
+#include "domain.hpp"
+#include "initial_conditions.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+class Writer {
+public:
+    explicit Writer(Transport::Buffer& out) : out(out) {}
+    template <class T>
+    void put(const T& value) {
+        size_t at = out.size();
+        out.resize(at + sizeof(T));
+        std::memcpy(out.data() + at, &value, sizeof(T));
+    }
+private:
+    Transport::Buffer& out;
+};
+
+class Reader {
+public:
+    explicit Reader(const Transport::Buffer& in) : in(in) {}
+    template <class T>
+    bool get(T& value) {
+        if (in.size() - pos < sizeof(T)) return false;
+        std::memcpy(&value, in.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    bool done() const { return pos == in.size(); }
+private:
+    const Transport::Buffer& in;
+    size_t pos = 0;
+};
+
+// Fields that cross ranks. Positions and velocities go as double and
+// absolute, whatever the build's Real; trail and orbitTarget stay behind.
+float Particle::* const kFloatFields[] = {
+    &Particle::radius, &Particle::mass, &Particle::charge, &Particle::eventHorizon,
+    &Particle::luminosity, &Particle::absorption, &Particle::orbitRadius, &Particle::orbitAngle,
+    &Particle::spin, &Particle::spinAngle, &Particle::temperature, &Particle::density,
+    &Particle::magneticField, &Particle::lifetime, &Particle::age, &Particle::restitution,
+};
+bool Particle::* const kFlagFields[] = {
+    &Particle::isStatic, &Particle::emitsLight, &Particle::decaying, &Particle::tidallyLocked,
+};
+
+void writeParticle(Writer& w, const PhysicsObject& p, double originX, double originY, bool components) {
+    w.put(originX + static_cast<double>(p.x));
+    w.put(originY + static_cast<double>(p.y));
+    w.put(static_cast<double>(p.vx));
+    w.put(static_cast<double>(p.vy));
+    for (auto field : kFloatFields) w.put(p.*field);
+    w.put(p.color);
+    w.put(p.trailLength);
+    w.put(static_cast<uint8_t>(p.type));
+    uint8_t flags = 0;
+    for (size_t k = 0; k < 4; ++k) flags |= (p.*kFlagFields[k] ? 1u : 0u) << k;
+    w.put(flags);
+    uint32_t count = components ? static_cast<uint32_t>(p.components.size()) : 0;
+    w.put(count);
+    for (uint32_t k = 0; k < count; ++k) writeParticle(w, p.components[k], originX, originY, true);
+}
+
+bool readParticle(Reader& r, PhysicsObject& p, double originX, double originY, int depth = 0) {
+    double x, y, vx, vy;
+    uint8_t type, flags;
+    uint32_t count;
+    if (!r.get(x) || !r.get(y) || !r.get(vx) || !r.get(vy)) return false;
+    for (auto field : kFloatFields) {
+        if (!r.get(p.*field)) return false;
+    }
+    if (!r.get(p.color) || !r.get(p.trailLength) || !r.get(type) || !r.get(flags) || !r.get(count)) return false;
+    p.x = static_cast<Real>(x - originX);
+    p.y = static_cast<Real>(y - originY);
+    p.vx = static_cast<Real>(vx);
+    p.vy = static_cast<Real>(vy);
+    p.type = static_cast<ObjectType>(type);
+    for (size_t k = 0; k < 4; ++k) p.*kFlagFields[k] = (flags >> k) & 1u;
+    p.trail = -1;
+    p.orbitTarget = -1;
+    if (count > 0 && depth > 64) return false;
+    p.components.resize(count);
+    for (auto& component : p.components) {
+        if (!readParticle(r, component, originX, originY, depth + 1)) return false;
+    }
+    return true;
+}
+
+// One coarse cell as it crosses ranks, absolute position
+struct WireSource {
+    double x, y;
+    float mass, qxx, qxy, qyy;
+};
+
+// Moments of a summary cell about its centre (cx, cy)
+struct CellMoments {
+    double m = 0, sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+};
+
+} // namespace
+
+DomainRank::DomainRank(PhysicsWorld& world, Transport& transport, DomainConfig config)
+    : world(world), transport(transport), config(config) {
+    world.history.enabled = false;
+    int ranks = transport.size();
+    cuts.assign(ranks + 1, 0.0);
+    cuts.front() = -std::numeric_limits<double>::infinity();
+    cuts.back() = std::numeric_limits<double>::infinity();
+}
+
+int DomainRank::owner(double x) const {
+    // Interior cuts only, so NaN and infinities still land on a rank
+    auto it = std::upper_bound(cuts.begin() + 1, cuts.end() - 1, x);
+    return static_cast<int>(it - (cuts.begin() + 1));
+}
+
+bool DomainRank::balance(Extent& global) {
+    const double inf = std::numeric_limits<double>::infinity();
+    int ranks = transport.size();
+    Extent mine = {inf, -inf, world.objects.size(), 0.0f, 0.0f};
+    for (const auto& obj : world.objects) {
+        double x = world.originX + static_cast<double>(obj.x);
+        mine.minX = std::min(mine.minX, x);
+        mine.maxX = std::max(mine.maxX, x);
+        mine.maxRadius = std::max(mine.maxRadius, obj.radius);
+        mine.maxSpeed = std::max(mine.maxSpeed, static_cast<float>(std::sqrt(obj.vx * obj.vx + obj.vy * obj.vy)));
+    }
+    Transport::Buffer message;
+    Writer(message).put(mine);
+    if (!transport.allGather(message, incoming)) return false;
+    global = {inf, -inf, 0, 0.0f, 0.0f};
+    for (const auto& in : incoming) {
+        Extent e;
+        if (!Reader(in).get(e)) return false;
+        global.minX = std::min(global.minX, e.minX);
+        global.maxX = std::max(global.maxX, e.maxX);
+        global.count += e.count;
+        global.maxRadius = std::max(global.maxRadius, e.maxRadius);
+        global.maxSpeed = std::max(global.maxSpeed, e.maxSpeed);
+    }
+    globalCount = static_cast<size_t>(global.count);
+    if (ranks == 1 || global.count == 0 || !(global.maxX - global.minX < inf)) return true;
+
+    // Cuts at the ranks' equal shares of a histogram of every body's x;
+    // all ranks see the same histogram, so they agree on the cuts
+    int bins = std::max(config.balanceBins, 1);
+    double width = std::max((global.maxX - global.minX) / bins, 1e-12);
+    std::vector<uint32_t> histogram(bins, 0);
+    for (const auto& obj : world.objects) {
+        double x = world.originX + static_cast<double>(obj.x);
+        int b = static_cast<int>((x - global.minX) / width);
+        histogram[std::min(std::max(b, 0), bins - 1)]++;
+    }
+    message.resize(histogram.size() * sizeof(uint32_t));
+    std::memcpy(message.data(), histogram.data(), message.size());
+    if (!transport.allGather(message, incoming)) return false;
+    std::vector<uint64_t> total(bins, 0);
+    for (const auto& in : incoming) {
+        if (in.size() != message.size()) return false;
+        for (int b = 0; b < bins; ++b) {
+            uint32_t n;
+            std::memcpy(&n, in.data() + b * sizeof(uint32_t), sizeof(uint32_t));
+            total[b] += n;
+        }
+    }
+    uint64_t below = 0;
+    int b = 0;
+    for (int r = 1; r < ranks; ++r) {
+        double target = static_cast<double>(global.count) * r / ranks;
+        while (b < bins - 1 && static_cast<double>(below + total[b]) < target) below += total[b++];
+        double fraction = total[b] ? (target - static_cast<double>(below)) / static_cast<double>(total[b]) : 0.0;
+        cuts[r] = global.minX + (b + std::min(std::max(fraction, 0.0), 1.0)) * width;
+    }
+    return true;
+}
+
+bool DomainRank::migrate() {
+    int ranks = transport.size();
+    int me = transport.rank();
+    outgoing.assign(ranks, {});
+    std::vector<Writer> writers;
+    for (auto& buffer : outgoing) writers.emplace_back(buffer);
+    auto& objects = world.objects;
+    size_t kept = 0;
+    migrated = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        int r = owner(world.originX + static_cast<double>(objects[i].x));
+        if (r == me) {
+            if (kept != i) objects[kept] = std::move(objects[i]);
+            ++kept;
+        } else {
+            writeParticle(writers[r], objects[i], world.originX, world.originY, true);
+            ++migrated;
+        }
+    }
+    objects.erase(objects.begin() + kept, objects.end());
+    world.invalidateNeighbours();
+    if (!transport.exchange(outgoing, incoming)) return false;
+    for (int from = 0; from < ranks; ++from) {
+        if (from == me) continue;
+        Reader reader(incoming[from]);
+        while (!reader.done()) {
+            objects.emplace_back();
+            if (!readParticle(reader, objects.back(), world.originX, world.originY)) return false;
+        }
+    }
+    world.revision++;
+    return true;
+}
+
+bool DomainRank::exchangeHalo(const Extent& global, float dt) {
+    int ranks = transport.size();
+    int me = transport.rank();
+    const auto& objects = world.objects;
+    // Two bodies touch at 2 x the largest radius and close at most
+    // 2 x the top speed over the step
+    double halo = 2.0 * global.maxRadius + 2.0 * global.maxSpeed * dt + config.haloWidth;
+
+    // Ranks whose slab plus halo holds each body, as a contiguous range
+    std::vector<std::pair<int, int>> reach(objects.size());
+    std::vector<uint32_t> ghostCount(ranks, 0);
+    double minX = std::numeric_limits<double>::infinity(), maxX = -minX, minY = minX, maxY = -minX;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        double x = world.originX + static_cast<double>(objects[i].x);
+        double y = world.originY + static_cast<double>(objects[i].y);
+        reach[i] = {owner(x - halo), owner(x + halo)};
+        for (int r = reach[i].first; r <= reach[i].second; ++r) ghostCount[r]++;
+        if (objects[i].isStatic) continue;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+
+    // Summary grid over this rank's own non-static bodies
+    int cells = std::max(config.summaryCells, 1);
+    double cellW = std::max((maxX - minX) / cells, 1e-12);
+    double cellH = std::max((maxY - minY) / cells, 1e-12);
+    std::vector<int> cellOf(objects.size(), -1);
+    for (size_t i = 0; i < objects.size(); ++i) {
+        if (objects[i].isStatic) continue;
+        int cx = static_cast<int>((world.originX + static_cast<double>(objects[i].x) - minX) / cellW);
+        int cy = static_cast<int>((world.originY + static_cast<double>(objects[i].y) - minY) / cellH);
+        cellOf[i] = std::min(cy, cells - 1) * cells + std::min(cx, cells - 1);
+    }
+
+    outgoing.assign(ranks, {});
+    std::vector<CellMoments> moments;
+    for (int r = 0; r < ranks; ++r) {
+        if (r == me) continue;
+        Writer w(outgoing[r]);
+        // Bodies in r's halo go across whole and are summed directly there;
+        // the summary for r holds everything else
+        w.put(ghostCount[r]);
+        moments.assign(static_cast<size_t>(cells) * cells, CellMoments());
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (r >= reach[i].first && r <= reach[i].second) {
+                writeParticle(w, objects[i], world.originX, world.originY, false);
+                continue;
+            }
+            if (cellOf[i] < 0) continue;
+            int cx = cellOf[i] % cells, cy = cellOf[i] / cells;
+            double dx = world.originX + static_cast<double>(objects[i].x) - (minX + (cx + 0.5) * cellW);
+            double dy = world.originY + static_cast<double>(objects[i].y) - (minY + (cy + 0.5) * cellH);
+            double m = objects[i].mass;
+            CellMoments& c = moments[cellOf[i]];
+            c.m += m;
+            c.sx += m * dx;
+            c.sy += m * dy;
+            c.sxx += m * dx * dx;
+            c.sxy += m * dx * dy;
+            c.syy += m * dy * dy;
+        }
+        uint32_t sources = 0;
+        for (const auto& c : moments) sources += c.m > 0.0 ? 1 : 0;
+        w.put(sources);
+        for (int k = 0; k < cells * cells; ++k) {
+            const CellMoments& c = moments[k];
+            if (!(c.m > 0.0)) continue;
+            // Second moments about the centre of mass, then the traceless
+            // quadrupole Q = 3C - tr(C) I
+            double mx = c.sx / c.m, my = c.sy / c.m;
+            double cxx = c.sxx - c.m * mx * mx;
+            double cxy = c.sxy - c.m * mx * my;
+            double cyy = c.syy - c.m * my * my;
+            WireSource s;
+            s.x = minX + (k % cells + 0.5) * cellW + mx;
+            s.y = minY + (k / cells + 0.5) * cellH + my;
+            s.mass = static_cast<float>(c.m);
+            s.qxx = static_cast<float>(2.0 * cxx - cyy);
+            s.qxy = static_cast<float>(3.0 * cxy);
+            s.qyy = static_cast<float>(2.0 * cyy - cxx);
+            w.put(s);
+        }
+    }
+    if (!transport.exchange(outgoing, incoming)) return false;
+
+    world.ghosts.clear();
+    world.farField.clear();
+    for (int from = 0; from < ranks; ++from) {
+        if (from == me) continue;
+        Reader reader(incoming[from]);
+        uint32_t count;
+        if (!reader.get(count)) return false;
+        for (uint32_t k = 0; k < count; ++k) {
+            world.ghosts.emplace_back();
+            PhysicsObject& ghost = world.ghosts.back();
+            if (!readParticle(reader, ghost, world.originX, world.originY)) return false;
+            if (!ghost.isStatic) world.farField.push_back({ghost.x, ghost.y, ghost.mass, 0.0f, 0.0f, 0.0f});
+        }
+        if (!reader.get(count)) return false;
+        for (uint32_t k = 0; k < count; ++k) {
+            WireSource s;
+            if (!reader.get(s)) return false;
+            world.farField.push_back({static_cast<Real>(s.x - world.originX), static_cast<Real>(s.y - world.originY),
+                                      s.mass, s.qxx, s.qxy, s.qyy});
+        }
+        if (!reader.done()) return false;
+    }
+    return true;
+}
+
+bool DomainRank::step(float dt) {
+    Extent global;
+    if (!balance(global) || !migrate() || !exchangeHalo(global, dt)) return false;
+    world.step(dt);
+    return true;
+}
+
+bool DomainRank::partitionReplicated() {
+    Extent global;
+    if (!balance(global)) return false;
+    int me = transport.rank();
+    auto& objects = world.objects;
+    objects.erase(std::remove_if(objects.begin(), objects.end(), [&](const PhysicsObject& obj) {
+        return owner(world.originX + static_cast<double>(obj.x)) != me;
+    }), objects.end());
+    world.invalidateNeighbours();
+    globalCount /= transport.size();
+    world.revision++;
+    return true;
+}
+
+bool DomainRank::gather(std::vector<PhysicsObject>& out) {
+    outgoing.assign(transport.size(), {});
+    Writer w(outgoing[0]);
+    for (const auto& obj : world.objects) writeParticle(w, obj, world.originX, world.originY, true);
+    if (!transport.exchange(outgoing, incoming)) return false;
+    out.clear();
+    if (transport.rank() != 0) return true;
+    for (const auto& in : incoming) {
+        Reader reader(in);
+        while (!reader.done()) {
+            out.emplace_back();
+            if (!readParticle(reader, out.back(), world.originX, world.originY)) return false;
+        }
+    }
+    return true;
+}
+
+bool DomainRank::sum(std::vector<double>& values) {
+    Transport::Buffer message(values.size() * sizeof(double));
+    if (!values.empty()) std::memcpy(message.data(), values.data(), message.size());
+    if (!transport.allGather(message, incoming)) return false;
+    std::fill(values.begin(), values.end(), 0.0);
+    for (const auto& in : incoming) {
+        if (in.size() != message.size()) return false;
+        for (size_t k = 0; k < values.size(); ++k) {
+            double v;
+            std::memcpy(&v, in.data() + k * sizeof(double), sizeof(double));
+            values[k] += v;
+        }
+    }
+    return true;
+}
+
+#ifndef _WIN32
+
+int launchLocalRanks(int ranks, const char* shmName, size_t capacity, size_t threadsPerRank,
+                     const std::function<int(Transport&, ThreadPool&)>& body) {
+    if (ranks < 1) return -1;
+    auto root = ShmTransport::create(shmName, ranks, capacity);
+    if (!root) {
+        std::cerr << "Cannot create shared memory segment " << shmName << "\n";
+        return -1;
+    }
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    size_t threads = threadsPerRank ? threadsPerRank : std::max<size_t>(1, cores / ranks);
+    // Flush first so buffered output is not written once per child
+    std::fflush(nullptr);
+    std::vector<pid_t> children;
+    for (int r = 1; r < ranks; ++r) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int code = 1;
+            {
+                auto transport = ShmTransport::attach(shmName, r);
+                if (transport) {
+                    ThreadPool pool(threads);
+                    code = body(*transport, pool);
+                }
+            }
+            std::fflush(nullptr);
+            _exit(code);
+        }
+        if (pid < 0) {
+            std::cerr << "fork failed for rank " << r << "\n";
+            for (pid_t child : children) kill(child, SIGTERM);
+            for (pid_t child : children) waitpid(child, nullptr, 0);
+            ShmTransport::unlink(shmName);
+            return -1;
+        }
+        children.push_back(pid);
+    }
+
+    int result;
+    {
+        ThreadPool pool(threads);
+        result = body(*root, pool);
+    }
+    for (pid_t child : children) {
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) result = result ? result : 1;
+    }
+    root.reset();
+    ShmTransport::unlink(shmName);
+    return result;
+}
+
+#else
+
+int launchLocalRanks(int, const char*, size_t, size_t, const std::function<int(Transport&, ThreadPool&)>&) {
+    std::cerr << "Local multi-process runs need POSIX shared memory\n";
+    return -1;
+}
+
+#endif
+
+int runDecomposed(int ranks, uint64_t steps, float dt, const char* input, const char* output) {
+    char name[64];
+#ifndef _WIN32
+    std::snprintf(name, sizeof(name), "/physics-domain-%ld", static_cast<long>(getpid()));
+#else
+    std::snprintf(name, sizeof(name), "/physics-domain");
+#endif
+    const size_t capacity = size_t(32) << 20;
+    return launchLocalRanks(ranks, name, capacity, 0, [&](Transport& transport, ThreadPool& pool) {
+        PhysicsWorld world;
+        world.threadPool = &pool;
+        world.openBoundary = true;
+        ImportResult loaded = importInitialConditions(world, input);
+        if (!loaded) {
+            std::cerr << "Failed to load " << input << ": " << loaded.error << "\n";
+            return 1;
+        }
+        DomainRank domain(world, transport);
+        bool root = transport.rank() == 0;
+        if (!domain.partitionReplicated()) return 1;
+        std::vector<double> totals;
+        for (uint64_t s = 0; s <= steps; ++s) {
+            if (s % 100 == 0 || s == steps) {
+                float px, py;
+                world.totalMomentum(px, py);
+                totals = {static_cast<double>(world.objects.size()), world.totalKineticEnergy(), px, py};
+                if (!domain.sum(totals)) return 1;
+                if (root) {
+                    std::printf("[step %llu] bodies %.0f  kinetic %.6g  momentum (%.6g, %.6g)\n",
+                                static_cast<unsigned long long>(s), totals[0], totals[1], totals[2], totals[3]);
+                    std::fflush(stdout);
+                }
+            }
+            if (s == steps) break;
+            if (!domain.step(dt)) {
+                std::cerr << "Rank " << transport.rank() << ": exchange failed at step " << s << "\n";
+                return 1;
+            }
+        }
+        if (!output) return 0;
+        std::vector<PhysicsObject> all;
+        if (!domain.gather(all)) return 1;
+        if (!root) return 0;
+        world.objects = std::move(all);
+        return exportColumnar(world, output) ? 0 : 1;
+    });
+}
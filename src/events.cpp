@@ -0,0 +1,113 @@
+#include "events.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+
+const char* eventTypeName(EventType type) {
+    switch (type) {
+        case EventType::Collision: return "Collision";
+        case EventType::Absorption: return "Absorption";
+        case EventType::TidalDisruption: return "Tidal Disruption";
+        case EventType::Supernova: return "Supernova";
+        case EventType::Expiry: return "Expiry";
+    }
+    return "Unknown";
+}
+
+void EventRing::reset(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    slots.reset(new PhysicsEvent[size]);
+    mask = size - 1;
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+int EventStream::subscribe(uint32_t filter, Callback fn) {
+    // Growing the list mid-drain would move the callback being run
+    (draining ? added : subscribers).push_back({nextId, filter & kAllEvents, std::move(fn)});
+    updateMask();
+    return nextId++;
+}
+
+void EventStream::unsubscribe(int id) {
+    added.erase(std::remove_if(added.begin(), added.end(), [&](const Subscriber& s) { return s.id == id; }),
+                added.end());
+    for (auto& s : subscribers) {
+        if (s.id != id) continue;
+        // Removed after the drain if one is delivering right now
+        s.mask = 0;
+        if (!draining) s.fn = nullptr;
+    }
+    if (!draining) {
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                         [](const Subscriber& s) { return !s.fn; }),
+                          subscribers.end());
+    }
+    updateMask();
+}
+
+void EventStream::updateMask() {
+    mask = 0;
+    for (const auto& s : subscribers) mask |= s.mask;
+    for (const auto& s : added) mask |= s.mask;
+}
+
+void EventStream::prepare(const ThreadPool& threads) {
+    pool = &threads;
+    size_t count = threads.size();
+    if (rings && ringCount == count && ringCapacity == capacity) return;
+    // Anything still queued under the old layout goes out first
+    if (rings) drain();
+    rings.reset(new EventRing[count]);
+    for (size_t k = 0; k < count; ++k) rings[k].reset(capacity);
+    ringCount = count;
+    ringCapacity = capacity;
+}
+
+void EventStream::emit(const PhysicsEvent& event) {
+    size_t slot = pool ? pool->workerIndex() : 0;
+    if (slot < ringCount) {
+        rings[slot].push(event);
+    } else {
+        ++droppedTotal;   // emitted before the first prepare()
+    }
+}
+
+void EventStream::drain() {
+    batch.clear();
+    for (size_t k = 0; k < ringCount; ++k) {
+        rings[k].drain([&](const PhysicsEvent& e) { batch.push_back(e); });
+        droppedTotal += rings[k].takeDropped();
+    }
+    if (batch.empty()) return;
+
+    draining = true;
+    for (size_t k = 0; k < subscribers.size(); ++k) {
+        uint32_t want = subscribers[k].mask;
+        if (want == 0) continue;
+        Span<const PhysicsEvent> events(batch);
+        if ((mask & ~want) != 0) {
+            filtered.clear();
+            for (const auto& e : batch) {
+                if (want & eventBit(e.type)) filtered.push_back(e);
+            }
+            if (filtered.empty()) continue;
+            events = Span<const PhysicsEvent>(filtered);
+        }
+        subscribers[k].fn(events);
+    }
+    draining = false;
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                     [](const Subscriber& s) { return s.mask == 0; }),
+                      subscribers.end());
+    // Subscribers added by a callback start with the next drain
+    for (auto& s : added) subscribers.push_back(std::move(s));
+    added.clear();
+}
+
+size_t EventStream::memoryUsage() const {
+    size_t slots = batch.capacity() + filtered.capacity();
+    for (size_t k = 0; k < ringCount; ++k) slots += rings[k].capacity();
+    return ringCount * sizeof(EventRing) + slots * sizeof(PhysicsEvent);
+}
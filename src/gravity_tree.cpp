@@ -0,0 +1,144 @@
+#include "gravity_tree.hpp"
+#include <algorithm>
+#include <cmath>
+
+void GravityTree::build(const std::vector<Particle>& objects, bool includeStatic) {
+    nodes.clear();
+    order.clear();
+    Real minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const auto& obj = objects[i];
+        if (obj.mass <= 0.0f || (obj.isStatic && !includeStatic)) continue;
+        if (!std::isfinite(obj.x) || !std::isfinite(obj.y)) continue;
+        order.push_back(static_cast<uint32_t>(i));
+        minX = std::min(minX, obj.x); maxX = std::max(maxX, obj.x);
+        minY = std::min(minY, obj.y); maxY = std::max(maxY, obj.y);
+    }
+    if (order.empty()) return;
+    
+    Node root;
+    root.centerX = 0.5f * (minX + maxX);
+    root.centerY = 0.5f * (minY + maxY);
+    root.half = 0.5f * std::max(maxX - minX, maxY - minY) * 1.001f + 1e-6f;
+    root.firstChild = -1;
+    root.begin = 0;
+    root.count = static_cast<uint32_t>(order.size());
+    nodes.reserve(order.size() / 2 + 1);
+    nodes.push_back(root);
+    subdivide(objects, 0, 0);
+    
+    bx.resize(order.size());
+    by.resize(order.size());
+    bm.resize(order.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        const auto& obj = objects[order[k]];
+        bx[k] = obj.x;
+        by[k] = obj.y;
+        bm[k] = obj.mass;
+    }
+}
+
+void GravityTree::subdivide(const std::vector<Particle>& objects, size_t node, int depth) {
+    Node n = nodes[node];
+    auto first = order.begin() + n.begin;
+    auto last = first + n.count;
+    
+    if (n.count <= kLeafSize || depth >= 24) {
+        float m = 0.0f;
+        Real mx = 0.0f, my = 0.0f;
+        for (auto it = first; it != last; ++it) {
+            const auto& obj = objects[*it];
+            m += obj.mass;
+            mx += obj.mass * obj.x;
+            my += obj.mass * obj.y;
+        }
+        nodes[node].mass = m;
+        nodes[node].comX = mx / m;
+        nodes[node].comY = my / m;
+        return;
+    }
+    
+    // Quadrants in order: (-x,-y), (-x,+y), (+x,-y), (+x,+y)
+    auto midX = std::partition(first, last, [&](uint32_t i) { return objects[i].x < n.centerX; });
+    auto midLo = std::partition(first, midX, [&](uint32_t i) { return objects[i].y < n.centerY; });
+    auto midHi = std::partition(midX, last, [&](uint32_t i) { return objects[i].y < n.centerY; });
+    auto bounds = {first, midLo, midX, midHi, last};
+    auto b = bounds.begin();
+    
+    int firstChild = static_cast<int>(nodes.size());
+    nodes[node].firstChild = firstChild;
+    Real h = 0.5f * n.half;
+    for (int q = 0; q < 4; ++q) {
+        Node c;
+        c.centerX = n.centerX + ((q & 2) ? h : -h);
+        c.centerY = n.centerY + ((q & 1) ? h : -h);
+        c.half = h;
+        c.firstChild = -1;
+        c.begin = static_cast<uint32_t>(b[q] - order.begin());
+        c.count = static_cast<uint32_t>(b[q + 1] - b[q]);
+        c.mass = 0.0f;
+        c.comX = c.centerX;
+        c.comY = c.centerY;
+        nodes.push_back(c);
+    }
+    
+    float m = 0.0f;
+    Real mx = 0.0f, my = 0.0f;
+    for (int q = 0; q < 4; ++q) {
+        size_t child = firstChild + q;
+        if (nodes[child].count == 0) continue;
+        subdivide(objects, child, depth + 1);
+        m += nodes[child].mass;
+        mx += nodes[child].mass * nodes[child].comX;
+        my += nodes[child].mass * nodes[child].comY;
+    }
+    nodes[node].mass = m;
+    nodes[node].comX = mx / m;
+    nodes[node].comY = my / m;
+}
+
+void GravityTree::field(Real x, Real y, float theta, float softeningSq,
+                        Accum& gx, Accum& gy, int skip) const {
+    gx = 0.0f;
+    gy = 0.0f;
+    if (nodes.empty()) return;
+    
+    Accum thetaSq = theta * theta;
+    uint32_t stack[128];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& n = nodes[stack[--top]];
+        if (n.count == 0) continue;
+        Accum dx = static_cast<Accum>(n.comX - x);
+        Accum dy = static_cast<Accum>(n.comY - y);
+        Accum distSq = dx * dx + dy * dy;
+        Accum size = static_cast<Accum>(2.0f * n.half);
+        
+        if (n.firstChild >= 0 && size * size < thetaSq * distSq) {
+            Accum r2 = distSq + softeningSq;
+            Accum inv = n.mass / (r2 * std::sqrt(r2));
+            gx += dx * inv;
+            gy += dy * inv;
+        } else if (n.firstChild >= 0) {
+            for (int q = 0; q < 4; ++q) stack[top++] = n.firstChild + q;
+        } else {
+            for (uint32_t k = n.begin; k < n.begin + n.count; ++k) {
+                if (static_cast<int>(order[k]) == skip) continue;
+                Accum bdx = static_cast<Accum>(bx[k] - x);
+                Accum bdy = static_cast<Accum>(by[k] - y);
+                Accum bDistSq = bdx * bdx + bdy * bdy;
+                if (bDistSq < 1e-8f) continue;
+                Accum r2 = bDistSq + softeningSq;
+                Accum inv = bm[k] / (r2 * std::sqrt(r2));
+                gx += bdx * inv;
+                gy += bdy * inv;
+            }
+        }
+    }
+}
+
+size_t GravityTree::memoryUsage() const {
+    return nodes.capacity() * sizeof(Node) + order.capacity() * sizeof(uint32_t)
+         + (bx.capacity() + by.capacity()) * sizeof(Real) + bm.capacity() * sizeof(float);
+}
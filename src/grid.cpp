@@ -1,8 +1,13 @@
 
 #include "grid.hpp"
 #include "physics.hpp"
+#include "gravity_tree.hpp"
+#include "thread_pool.hpp"
+#include "fast_math.hpp"
+#include "line_batch.hpp"
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 GridRenderer::GridRenderer(int fieldN_, float arrowScale_, float arrowAlpha_)
     : fieldN(fieldN_), arrowScale(arrowScale_), arrowAlpha(arrowAlpha_) {}
@@ -13,67 +18,106 @@ void GridRenderer::drawAxes(GLuint axisProgram, GLuint axisVAO, int axisVertexCo
     glDrawArrays(GL_LINES, 0, axisVertexCount);
 }
 
-void GridRenderer::drawField(const PhysicsWorld& world, GLuint axisProgram, GLint colorLoc) {
-    glUseProgram(axisProgram);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    float logMinG = 1e6f;
-    float logMaxG = -1e6f;
-    std::vector<float> gNorms;
-    if (!world.objects.empty()) {
-        gNorms.resize(fieldN * fieldN, 0.0f);
-        // First pass: compute all gNorms
-        for (int i = 0; i < fieldN; ++i) {
+void GridRenderer::setFieldResolution(int n) {
+    fieldN = std::max(2, n);
+}
+
+void GridRenderer::computeField(const PhysicsWorld& world, const Camera2D& camera) {
+    float minX, minY, maxX, maxY;
+    camera.viewRect(minX, minY, maxX, maxY);
+    float step = (maxX - minX) / (fieldN - 1);
+    if (cachedWorld == &world && cachedRevision == world.revision &&
+        cachedCount == world.objects.size() && cachedN == fieldN && cachedFast == world.fastMath &&
+        sampleX0 == minX && sampleY0 == minY && sampleStep == step) {
+        return;
+    }
+    sampleX0 = minX;
+    sampleY0 = minY;
+    sampleStep = step;
+    cachedWorld = &world;
+    cachedRevision = world.revision;
+    cachedCount = world.objects.size();
+    cachedN = fieldN;
+    cachedFast = world.fastMath;
+    
+    size_t samples = static_cast<size_t>(fieldN) * fieldN;
+    fieldGX.assign(samples, 0.0f);
+    fieldGY.assign(samples, 0.0f);
+    fieldNorm.assign(samples, 0.0f);
+    
+    // Large worlds go through the same Barnes-Hut tree as the gravity solver
+    const auto& objects = world.objects;
+    bool useTree = objects.size() > treeThreshold;
+    if (useTree) fieldTree.build(objects, true);
+    const GravityTree& tree = fieldTree;
+    float theta = world.gravityTheta > 0.0f ? world.gravityTheta : fieldTheta;
+    
+    // One row of samples per index; rows are independent
+    ThreadPool::shared().parallelFor(fieldN, [&](size_t rowBegin, size_t rowEnd) {
+        for (size_t i = rowBegin; i < rowEnd; ++i) {
+            float x = sampleX0 + sampleStep * i;
             for (int j = 0; j < fieldN; ++j) {
-                float x = -1.0f + 2.0f * i / (fieldN - 1);
-                float y = -1.0f + 2.0f * j / (fieldN - 1);
+                float y = sampleY0 + sampleStep * j;
                 float gx = 0.0f, gy = 0.0f;
-                for (const auto& obj : world.objects) {
-                    float dx = obj.x - x;
-                    float dy = obj.y - y;
-                    float distSq = dx * dx + dy * dy + 1e-6f;
-                    float F = obj.mass / distSq;
-                    gx += F * dx / std::sqrt(distSq);
-                    gy += F * dy / std::sqrt(distSq);
+                if (useTree) {
+                    Accum tx, ty;
+                    tree.field(x, y, theta, 1e-6f, tx, ty);
+                    gx = static_cast<float>(tx);
+                    gy = static_cast<float>(ty);
+                } else {
+                    for (const auto& obj : objects) {
+                        float dx = obj.x - x;
+                        float dy = obj.y - y;
+                        float distSq = dx * dx + dy * dy + 1e-6f;
+                        float inv = obj.mass / (distSq * std::sqrt(distSq));
+                        gx += dx * inv;
+                        gy += dy * inv;
+                    }
                 }
-                float gNorm = std::sqrt(gx * gx + gy * gy);
-                gNorms[i * fieldN + j] = gNorm;
+                size_t idx = i * fieldN + j;
+                fieldGX[idx] = gx;
+                fieldGY[idx] = gy;
+                fieldNorm[idx] = std::sqrt(gx * gx + gy * gy);
             }
         }
-        // Second pass: find min/max logG (ignore zeros)
-        for (int idx = 0; idx < fieldN * fieldN; ++idx) {
-            float gNorm = gNorms[idx];
-            if (gNorm > 1e-8f) {
-                float lg = std::log10(gNorm);
-                if (lg < logMinG) logMinG = lg;
-                if (lg > logMaxG) logMaxG = lg;
-            }
-        }
-        if (logMaxG - logMinG < 1e-3f) {
-            logMaxG = logMinG + 1.0f;
+    });
+    
+    // Colour range over log|g| (ignoring zeros)
+    logMinG = 1e6f;
+    logMaxG = -1e6f;
+    for (float gNorm : fieldNorm) {
+        if (gNorm > 1e-8f) {
+            float lg = world.fastMath ? fastLog10(gNorm) : std::log10(gNorm);
+            if (lg < logMinG) logMinG = lg;
+            if (lg > logMaxG) logMaxG = lg;
         }
     }
+    if (logMaxG - logMinG < 1e-3f) {
+        logMaxG = logMinG + 1.0f;
+    }
+}
+
+void GridRenderer::drawField(const PhysicsWorld& world, const Camera2D& camera, LineBatch& lines) {
     // Only draw arrows if there are objects
     if (!world.objects.empty()) {
+        computeField(world, camera);
+        // Keep arrows from overlapping on dense grids; lengths are in screen terms
+        float density = std::min(1.0f, 20.0f / fieldN);
+        float scale = arrowScale * density / camera.zoom;
+        float ah = 0.02f * density / camera.zoom;
         for (int i = 0; i < fieldN; ++i) {
             for (int j = 0; j < fieldN; ++j) {
-                float x = -1.0f + 2.0f * i / (fieldN - 1);
-                float y = -1.0f + 2.0f * j / (fieldN - 1);
-                float gx = 0.0f, gy = 0.0f;
-                for (const auto& obj : world.objects) {
-                    float dx = obj.x - x;
-                    float dy = obj.y - y;
-                    float distSq = dx * dx + dy * dy + 1e-6f;
-                    float F = obj.mass / distSq;
-                    gx += F * dx / std::sqrt(distSq);
-                    gy += F * dy / std::sqrt(distSq);
-                }
-                float gNorm = std::sqrt(gx * gx + gy * gy);
+                float x = sampleX0 + sampleStep * i;
+                float y = sampleY0 + sampleStep * j;
+                size_t idx = static_cast<size_t>(i) * fieldN + j;
+                float gx = fieldGX[idx], gy = fieldGY[idx];
+                float gNorm = fieldNorm[idx];
                 if (gNorm > 1e-6f) {
                     gx /= gNorm;
                     gy /= gNorm;
                 }
-                float logG = (gNorm > 1e-8f) ? std::log10(gNorm) : logMinG;
+                float logG = logMinG;
+                if (gNorm > 1e-8f) logG = world.fastMath ? fastLog10(gNorm) : std::log10(gNorm);
                 float norm = (logG - logMinG) / (logMaxG - logMinG);
                 if (norm < 0.0f) norm = 0.0f;
                 if (norm > 1.0f) norm = 1.0f;
@@ -109,54 +153,16 @@ void GridRenderer::drawField(const PhysicsWorld& world, GLuint axisProgram, GLin
                     g = 0.0f;
                     b = 0.0f;
                 }
-                float x2 = x + gx * arrowScale;
-                float y2 = y + gy * arrowScale;
-                std::vector<float> arrow = {x, y, x2, y2};
-                GLuint arrowVAO, arrowVBO;
-                glGenVertexArrays(1, &arrowVAO);
-                glGenBuffers(1, &arrowVBO);
-                glBindVertexArray(arrowVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, arrowVBO);
-                glBufferData(GL_ARRAY_BUFFER, arrow.size() * sizeof(float), arrow.data(), GL_DYNAMIC_DRAW);
-                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-                glEnableVertexAttribArray(0);
-                glUniform3f(colorLoc, r, g, b);
-                glDrawArrays(GL_LINES, 0, 2);
+                float x2 = x + gx * scale;
+                float y2 = y + gy * scale;
+                Color3 color = {r, g, b};
+                lines.addLine(x, y, x2, y2, color);
                 // Arrow head
-                float ah = 0.02f;
                 float ax = x2 - gx * ah, ay = y2 - gy * ah;
                 float perpX = -gy, perpY = gx;
-                std::vector<float> head1 = {x2, y2, ax + perpX * ah, ay + perpY * ah};
-                std::vector<float> head2 = {x2, y2, ax - perpX * ah, ay - perpY * ah};
-                GLuint h1VAO, h1VBO, h2VAO, h2VBO;
-                glGenVertexArrays(1, &h1VAO);
-                glGenBuffers(1, &h1VBO);
-                glBindVertexArray(h1VAO);
-                glBindBuffer(GL_ARRAY_BUFFER, h1VBO);
-                glBufferData(GL_ARRAY_BUFFER, head1.size() * sizeof(float), head1.data(), GL_DYNAMIC_DRAW);
-                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-                glEnableVertexAttribArray(0);
-                glUniform3f(colorLoc, r, g, b);
-                glDrawArrays(GL_LINES, 0, 2);
-                glDeleteVertexArrays(1, &h1VAO);
-                glDeleteBuffers(1, &h1VBO);
-                glGenVertexArrays(1, &h2VAO);
-                glGenBuffers(1, &h2VBO);
-                glBindVertexArray(h2VAO);
-                glBindBuffer(GL_ARRAY_BUFFER, h2VBO);
-                glBufferData(GL_ARRAY_BUFFER, head2.size() * sizeof(float), head2.data(), GL_DYNAMIC_DRAW);
-                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-                glEnableVertexAttribArray(0);
-                glUniform3f(colorLoc, r, g, b);
-                glDrawArrays(GL_LINES, 0, 2);
-                glDeleteVertexArrays(1, &h2VAO);
-                glDeleteBuffers(1, &h2VBO);
-                glDeleteVertexArrays(1, &arrowVAO);
-                glDeleteBuffers(1, &arrowVBO);
+                lines.addLine(x2, y2, ax + perpX * ah, ay + perpY * ah, color);
+                lines.addLine(x2, y2, ax - perpX * ah, ay - perpY * ah, color);
             }
         }
     }
-    glDisable(GL_BLEND);
-    // Restore OpenGL color state to white after drawing field arrows
-    glUniform3f(colorLoc, 1.0f, 1.0f, 1.0f);
 }
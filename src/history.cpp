@@ -0,0 +1,243 @@
+#include "history.hpp"
+#include "physics.hpp"
+#include <algorithm>
+#include <cstring>
+
+SimulationHistory::HotState SimulationHistory::capture(const Particle& p) {
+    // Zero first: deltas are found by memcmp, and mixed Real/float members leave padding
+    HotState s;
+    std::memset(&s, 0, sizeof(s));
+    s.x = p.x; s.y = p.y;
+    s.vx = p.vx; s.vy = p.vy;
+    s.mass = p.mass; s.radius = p.radius;
+    s.spin = p.spin; s.spinAngle = p.spinAngle; s.orbitAngle = p.orbitAngle;
+    s.temperature = p.temperature; s.age = p.age;
+    s.sleepTime = p.sleepTime; s.sleeping = p.sleeping;
+    s.sleepPullX = p.sleepPullX; s.sleepPullY = p.sleepPullY; s.sleepIsland = p.sleepIsland;
+    return s;
+}
+
+void SimulationHistory::apply(const HotState& s, Particle& p) {
+    p.x = s.x; p.y = s.y;
+    p.vx = s.vx; p.vy = s.vy;
+    p.mass = s.mass; p.radius = s.radius;
+    p.spin = s.spin; p.spinAngle = s.spinAngle; p.orbitAngle = s.orbitAngle;
+    p.temperature = s.temperature; p.age = s.age;
+    p.sleepTime = s.sleepTime; p.sleeping = s.sleeping;
+    p.sleepPullX = s.sleepPullX; p.sleepPullY = s.sleepPullY; p.sleepIsland = s.sleepIsland;
+}
+
+SimulationHistory::StatsSnapshot SimulationHistory::captureStats(const PhysicsWorld& world) {
+    return {world.stats.totalCollisions, world.stats.objectsAbsorbed, world.stats.totalEnergyLost,
+            world.originX, world.originY, world.randomStreams,
+            world.sleepGravity, world.sleepWalls, world.sleepOpen, world.sleepIslandCount};
+}
+
+size_t SimulationHistory::keyframeBytes(const Segment& seg) {
+    return (seg.keyframe.capacity() + seg.components.capacity()) * sizeof(Particle)
+         + seg.componentStart.capacity() * sizeof(uint32_t);
+}
+
+size_t SimulationHistory::deltaBytes(const Delta& d) {
+    return sizeof(Delta) + d.indices.capacity() * sizeof(uint32_t) + d.states.capacity() * sizeof(HotState);
+}
+
+uint64_t SimulationHistory::oldestStep() const {
+    return segmentCount == 0 ? 0 : segment(0).step;
+}
+
+uint64_t SimulationHistory::newestStep() const {
+    return segmentCount == 0 ? 0 : segment(segmentCount - 1).lastStep();
+}
+
+size_t SimulationHistory::frameCount() const {
+    size_t count = 0;
+    for (size_t k = 0; k < segmentCount; ++k) count += 1 + segment(k).deltas.size();
+    return count;
+}
+
+void SimulationHistory::clear() {
+    ring.clear();
+    ringFirst = 0;
+    segmentCount = 0;
+    spareDeltas.clear();
+    lastState.clear();
+    lastTypes.clear();
+    bytesUsed = 0;
+}
+
+void SimulationHistory::rememberState(const std::vector<Particle>& objects) {
+    lastState.resize(objects.size());
+    lastTypes.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        lastState[i] = capture(objects[i]);
+        lastTypes[i] = objects[i].type;
+    }
+}
+
+void SimulationHistory::recycle(Delta& delta) {
+    // One segment's worth is enough to cover the next one
+    if (spareDeltas.size() >= keyframeInterval) return;
+    spareDeltas.push_back(std::move(delta));
+}
+
+void SimulationHistory::recycle(Segment& seg) {
+    // The keyframe and delta list stay in the ring slot
+    for (auto& d : seg.deltas) recycle(d);
+    seg.deltas.clear();
+}
+
+SimulationHistory::Segment& SimulationHistory::pushSegment() {
+    if (segmentCount == ring.size()) {
+        std::vector<Segment> grown(std::max<size_t>(4, 2 * ring.size()));
+        for (size_t k = 0; k < segmentCount; ++k) grown[k] = std::move(segment(k));
+        ring.swap(grown);
+        ringFirst = 0;
+    }
+    ++segmentCount;
+    return newest();
+}
+
+void SimulationHistory::truncateFrom(uint64_t step) {
+    while (segmentCount > 0 && newest().step >= step) {
+        bytesUsed -= newest().bytes;
+        recycle(newest());
+        --segmentCount;
+    }
+    if (segmentCount == 0) return;
+    auto& deltas = newest().deltas;
+    while (!deltas.empty() && deltas.back().step >= step) {
+        const auto& d = deltas.back();
+        size_t bytes = deltaBytes(d);
+        newest().bytes -= bytes;
+        bytesUsed -= bytes;
+        recycle(deltas.back());
+        deltas.pop_back();
+    }
+}
+
+void SimulationHistory::pushKeyframe(const PhysicsWorld& world) {
+    const auto& objects = world.objects;
+    Segment& seg = pushSegment();
+    seg.step = world.stepCount;
+    seg.stats = captureStats(world);
+    // Bodies are copied without their components, which would each allocate;
+    // those go to the segment's flat component list
+    seg.keyframe.resize(objects.size());
+    seg.componentStart.resize(objects.size() + 1);
+    seg.components.clear();
+    for (size_t i = 0; i < objects.size(); ++i) {
+        static_cast<ParticleFields&>(seg.keyframe[i]) = objects[i];
+        seg.componentStart[i] = static_cast<uint32_t>(seg.components.size());
+        seg.components.insert(seg.components.end(), objects[i].components.begin(), objects[i].components.end());
+    }
+    seg.componentStart[objects.size()] = static_cast<uint32_t>(seg.components.size());
+    seg.deltas.reserve(keyframeInterval);
+    seg.bytes = sizeof(Segment) + keyframeBytes(seg);
+    bytesUsed += seg.bytes;
+    rememberState(objects);
+}
+
+void SimulationHistory::enforceBudget() {
+    // Always keep the segment being appended to, even if it alone is over budget
+    while (bytesUsed > memoryBudget && segmentCount > 1) {
+        bytesUsed -= segment(0).bytes;
+        recycle(segment(0));
+        ringFirst = (ringFirst + 1) % ring.size();
+        --segmentCount;
+    }
+}
+
+void SimulationHistory::record(const PhysicsWorld& world) {
+    if (!enabled) return;
+
+    const uint64_t step = world.stepCount;
+    if (segmentCount > 0 && step <= newestStep()) {
+        truncateFrom(step);
+    }
+
+    const auto& objects = world.objects;
+    bool needKeyframe = segmentCount == 0
+        || step != newestStep() + 1
+        || step - newest().step >= keyframeInterval
+        || objects.size() != lastState.size();
+    for (size_t i = 0; !needKeyframe && i < objects.size(); ++i) {
+        if (objects[i].type != lastTypes[i]) needKeyframe = true;
+    }
+
+    if (needKeyframe) {
+        pushKeyframe(world);
+    } else {
+        changedIndices.clear();
+        changedStates.clear();
+        for (size_t i = 0; i < objects.size(); ++i) {
+            HotState s = capture(objects[i]);
+            if (std::memcmp(&s, &lastState[i], sizeof(HotState)) != 0) {
+                changedIndices.push_back(static_cast<uint32_t>(i));
+                changedStates.push_back(s);
+                lastState[i] = s;
+            }
+        }
+        Delta d;
+        if (!spareDeltas.empty()) {
+            d = std::move(spareDeltas.back());
+            spareDeltas.pop_back();
+        }
+        d.step = step;
+        d.stats = captureStats(world);
+        d.indices.assign(changedIndices.begin(), changedIndices.end());
+        d.states.assign(changedStates.begin(), changedStates.end());
+        size_t bytes = deltaBytes(d);
+        newest().bytes += bytes;
+        bytesUsed += bytes;
+        newest().deltas.push_back(std::move(d));
+    }
+
+    enforceBudget();
+}
+
+bool SimulationHistory::seek(uint64_t step, PhysicsWorld& world) {
+    for (size_t s = 0; s < segmentCount; ++s) {
+        const Segment& seg = segment(s);
+        if (step < seg.step || step > seg.lastStep()) continue;
+
+        world.objects.resize(seg.keyframe.size());
+        for (size_t i = 0; i < seg.keyframe.size(); ++i) {
+            auto& obj = world.objects[i];
+            static_cast<ParticleFields&>(obj) = seg.keyframe[i];
+            obj.components.assign(seg.components.begin() + seg.componentStart[i],
+                                  seg.components.begin() + seg.componentStart[i + 1]);
+        }
+        StatsSnapshot stats = seg.stats;
+        for (const auto& d : seg.deltas) {
+            if (d.step > step) break;
+            for (size_t k = 0; k < d.indices.size(); ++k) {
+                apply(d.states[k], world.objects[d.indices[k]]);
+            }
+            stats = d.stats;
+        }
+        world.stats.totalCollisions = stats.totalCollisions;
+        world.stats.objectsAbsorbed = stats.objectsAbsorbed;
+        world.stats.totalEnergyLost = stats.totalEnergyLost;
+        world.randomStreams = stats.randomStreams;
+        world.sleepGravity = stats.sleepGravity;
+        world.sleepWalls = stats.sleepWalls;
+        world.sleepOpen = stats.sleepOpen;
+        world.sleepIslandCount = stats.sleepIslandCount;
+        world.wokenIslands.clear();
+        // Objects are back in the frame's coordinates; bring fields, walls and trails along
+        if (stats.originX != world.originX || stats.originY != world.originY) {
+            world.shiftFrameState(static_cast<Real>(stats.originX - world.originX),
+                                  static_cast<Real>(stats.originY - world.originY));
+            world.originX = stats.originX;
+            world.originY = stats.originY;
+        }
+        world.stepCount = step;
+        ++world.revision;
+        world.invalidateNeighbours();
+        world.trails.sync(world.objects);
+        rememberState(world.objects);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,395 @@
+#include "initial_conditions.hpp"
+#include "physics.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char kMagic[4] = {'P', 'H', 'I', 'C'};
+const uint32_t kVersion = 1;
+const uint32_t kAllColumns = (1u << IcColumnCount) - 1;
+
+size_t columnWidth(uint32_t column, bool doublePositions) {
+    switch (column) {
+        case IcX: case IcY: case IcVX: case IcVY: return doublePositions ? 8 : 4;
+        case IcType: return 1;
+        case IcColor: return 12;
+        default: return 4;
+    }
+}
+
+size_t align8(size_t offset) { return (offset + 7) & ~size_t(7); }
+
+template <class T>
+T load(const unsigned char* column, size_t i) {
+    // Compiles to a plain load; the mapping is read in place
+    T value;
+    std::memcpy(&value, column + i * sizeof(T), sizeof(T));
+    return value;
+}
+
+ObjectType typeFromCode(unsigned code) {
+    // Unknown codes load as plain bodies rather than failing the whole file
+    return code <= static_cast<unsigned>(ObjectType::RockyPlanet) ? static_cast<ObjectType>(code)
+                                                                  : ObjectType::Normal;
+}
+
+// CSV fields, also the index into kCsvNames
+enum CsvField { CsvX, CsvY, CsvVX, CsvVY, CsvRadius, CsvMass, CsvType, CsvR, CsvG, CsvB,
+                CsvTemperature, CsvFieldCount };
+const char* const kCsvNames[CsvFieldCount] = {"x", "y", "vx", "vy", "radius", "mass", "type",
+                                               "r", "g", "b", "temperature"};
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+void trim(const char*& begin, const char*& end) {
+    while (begin < end && isBlank(*begin)) ++begin;
+    while (end > begin && isBlank(end[-1])) --end;
+}
+
+bool equalsIgnoreCase(const char* begin, const char* end, const char* name) {
+    size_t n = std::strlen(name);
+    if (static_cast<size_t>(end - begin) != n) return false;
+    for (size_t k = 0; k < n; ++k) {
+        char c = begin[k];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != name[k]) return false;
+    }
+    return true;
+}
+
+bool parseNumber(const char* begin, const char* end, double& value) {
+    if (begin < end && *begin == '+') ++begin;
+    auto res = std::from_chars(begin, end, value);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+// Data lines hold a body; blank lines and '#' comments are skipped
+bool isDataLine(const char* begin, const char* end) {
+    while (begin < end && isBlank(*begin)) ++begin;
+    return begin < end && *begin != '#';
+}
+
+struct CsvChunk {
+    const char* begin;
+    const char* end;
+    size_t rows = 0;        // data lines in the chunk
+    size_t lines = 0;       // all lines, for error messages
+    size_t firstRow = 0;
+    size_t firstLine = 0;
+    size_t errorLine = 0;   // 0 = no error
+    std::string error;
+};
+
+bool parseCsvRow(const char* begin, const char* end, const std::vector<int>& fieldOf, double originX,
+                 double originY, Particle& p, std::string& error) {
+    size_t index = 0;
+    const char* field = begin;
+    for (;;) {
+        const char* fieldEnd = std::find(field, end, ',');
+        if (index < fieldOf.size() && fieldOf[index] >= 0) {
+            const char* b = field;
+            const char* e = fieldEnd;
+            trim(b, e);
+            int column = fieldOf[index];
+            double v = 0.0;
+            if (column == CsvType) {
+                if (!parseObjectType(b, e, p.type)) {
+                    error = "bad type '" + std::string(b, e) + "'";
+                    return false;
+                }
+            } else if (!parseNumber(b, e, v)) {
+                error = "bad " + std::string(kCsvNames[column]) + " '" + std::string(b, e) + "'";
+                return false;
+            } else {
+                switch (column) {
+                    case CsvX: p.x = static_cast<Real>(v - originX); break;
+                    case CsvY: p.y = static_cast<Real>(v - originY); break;
+                    case CsvVX: p.vx = static_cast<Real>(v); break;
+                    case CsvVY: p.vy = static_cast<Real>(v); break;
+                    case CsvRadius: p.radius = static_cast<float>(v); break;
+                    case CsvMass: p.mass = static_cast<float>(v); break;
+                    case CsvR: p.color.r = static_cast<float>(v); break;
+                    case CsvG: p.color.g = static_cast<float>(v); break;
+                    case CsvB: p.color.b = static_cast<float>(v); break;
+                    case CsvTemperature: p.temperature = static_cast<float>(v); break;
+                }
+            }
+        }
+        ++index;
+        if (fieldEnd == end) break;
+        field = fieldEnd + 1;
+    }
+    if (index < fieldOf.size()) {
+        error = "expected " + std::to_string(fieldOf.size()) + " fields, found " + std::to_string(index);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool parseObjectType(const char* begin, const char* end, ObjectType& type) {
+    static const char* const names[] = {"normal", "merged", "blackhole", "star", "planet", "asteroid",
+                                        "comet", "neutronstar", "whitedwarf", "gasgiant", "rockyplanet"};
+    unsigned code = 0;
+    auto res = std::from_chars(begin, end, code);
+    if (res.ec == std::errc() && res.ptr == end) {
+        if (code > static_cast<unsigned>(ObjectType::RockyPlanet)) return false;
+        type = static_cast<ObjectType>(code);
+        return true;
+    }
+    for (unsigned k = 0; k < sizeof(names) / sizeof(names[0]); ++k) {
+        if (equalsIgnoreCase(begin, end, names[k])) {
+            type = static_cast<ObjectType>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+ImportResult importColumnar(PhysicsWorld& world, const char* path) {
+    ImportResult result;
+    MappedFile file;
+    if (!file.open(path)) {
+        result.error = std::string("cannot open ") + path;
+        return result;
+    }
+    ColumnarHeader header;
+    if (file.size() < sizeof(header)) {
+        result.error = "file too short for a header";
+        return result;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion) {
+        result.error = "not a version 1 PHIC file";
+        return result;
+    }
+    if ((header.columns & ~kAllColumns) != 0) {
+        result.error = "unknown columns";
+        return result;
+    }
+
+    // Locate every present column, checking it fits before touching it
+    const bool doublePositions = (header.flags & IcDoublePositions) != 0;
+    const size_t count = static_cast<size_t>(header.count);
+    const unsigned char* columns[IcColumnCount] = {};
+    size_t offset = sizeof(header);
+    for (uint32_t c = 0; c < IcColumnCount; ++c) {
+        uint32_t bit = 1u << c;
+        if (!(header.columns & bit)) continue;
+        size_t width = columnWidth(bit, doublePositions);
+        offset = align8(offset);
+        if (offset > file.size() || count > (file.size() - offset) / width) {
+            result.error = "file truncated";
+            return result;
+        }
+        columns[c] = file.data() + offset;
+        offset += count * width;
+    }
+
+    // Files hold absolute coordinates; objects are relative to the origin
+    auto value = [&](int c, size_t i) -> double {
+        return doublePositions ? load<double>(columns[c], i) : static_cast<double>(load<float>(columns[c], i));
+    };
+    const double originX = world.originX, originY = world.originY;
+    const bool hasColor = columns[7] != nullptr;
+    const bool hasTemperature = columns[8] != nullptr;
+
+    Span<PhysicsObject> out = world.appendObjects(count);
+    world.pool().parallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Particle& p = out[i];
+            if (columns[0]) p.x = static_cast<Real>(value(0, i) - originX);
+            if (columns[1]) p.y = static_cast<Real>(value(1, i) - originY);
+            if (columns[2]) p.vx = static_cast<Real>(value(2, i));
+            if (columns[3]) p.vy = static_cast<Real>(value(3, i));
+            p.radius = columns[4] ? load<float>(columns[4], i) : 0.01f;
+            p.mass = columns[5] ? load<float>(columns[5], i) : 1.0f;
+            if (columns[6]) p.type = typeFromCode(columns[6][i]);
+            if (hasColor) std::memcpy(&p.color, columns[7] + i * 12, 12);
+            if (hasTemperature) p.temperature = load<float>(columns[8], i);
+            ParticleUtils::applyTypeDefaults(p, hasColor, hasTemperature);
+        }
+    }, 4096);
+    result.imported = count;
+    return result;
+}
+
+ImportResult importCsv(PhysicsWorld& world, const char* path) {
+    ImportResult result;
+    MappedFile file;
+    if (!file.open(path)) {
+        result.error = std::string("cannot open ") + path;
+        return result;
+    }
+    const char* data = reinterpret_cast<const char*>(file.data());
+    const char* dataEnd = data + file.size();
+
+    // Header (after any leading blank or '#' lines): map each field
+    // position to the column it fills, -1 = ignored
+    size_t headerLine = 1;
+    const char* headerEnd = std::find(data, dataEnd, '\n');
+    while (headerEnd < dataEnd && !isDataLine(data, headerEnd)) {
+        data = headerEnd + 1;
+        headerEnd = std::find(data, dataEnd, '\n');
+        ++headerLine;
+    }
+    std::vector<int> fieldOf;
+    bool seen[CsvFieldCount] = {};
+    for (const char* field = data;;) {
+        const char* fieldEnd = std::find(field, headerEnd, ',');
+        const char* b = field;
+        const char* e = fieldEnd;
+        trim(b, e);
+        int column = -1;
+        for (int c = 0; c < CsvFieldCount; ++c) {
+            if (equalsIgnoreCase(b, e, kCsvNames[c])) column = c;
+        }
+        if (column >= 0 && seen[column]) column = -1;
+        if (column >= 0) seen[column] = true;
+        fieldOf.push_back(column);
+        if (fieldEnd == headerEnd) break;
+        field = fieldEnd + 1;
+    }
+    if (!seen[CsvX] || !seen[CsvY]) {
+        result.error = "CSV header needs x and y columns";
+        return result;
+    }
+    const bool hasColor = seen[CsvR] && seen[CsvG] && seen[CsvB];
+    const bool hasTemperature = seen[CsvTemperature];
+
+    // Split the body into chunks that start on line boundaries
+    const char* body = headerEnd < dataEnd ? headerEnd + 1 : dataEnd;
+    size_t bodySize = static_cast<size_t>(dataEnd - body);
+    ThreadPool& pool = world.pool();
+    size_t chunkCount = std::max<size_t>(1, std::min(pool.size() * 8, bodySize >> 20));
+    std::vector<CsvChunk> chunks(chunkCount);
+    const char* cursor = body;
+    for (size_t k = 0; k < chunkCount; ++k) {
+        const char* cut = k + 1 == chunkCount ? dataEnd : body + bodySize / chunkCount * (k + 1);
+        if (cut < cursor) cut = cursor;
+        if (cut < dataEnd) {
+            cut = std::find(cut, dataEnd, '\n');
+            if (cut < dataEnd) ++cut;
+        }
+        chunks[k].begin = cursor;
+        chunks[k].end = cut;
+        cursor = cut;
+    }
+
+    // Pass 1: count rows per chunk so every row knows its slot
+    pool.parallelFor(chunkCount, [&](size_t k0, size_t k1) {
+        for (size_t k = k0; k < k1; ++k) {
+            for (const char* line = chunks[k].begin; line < chunks[k].end;) {
+                const char* lineEnd = std::find(line, chunks[k].end, '\n');
+                if (isDataLine(line, lineEnd)) ++chunks[k].rows;
+                ++chunks[k].lines;
+                line = lineEnd + 1;
+            }
+        }
+    });
+    size_t rows = 0, lines = 0;
+    for (auto& chunk : chunks) {
+        chunk.firstRow = rows;
+        chunk.firstLine = lines;
+        rows += chunk.rows;
+        lines += chunk.lines;
+    }
+
+    // Pass 2: parse straight into the world's new objects
+    size_t firstObject = world.objects.size();
+    Span<PhysicsObject> out = world.appendObjects(rows);
+    pool.parallelFor(chunkCount, [&](size_t k0, size_t k1) {
+        for (size_t k = k0; k < k1; ++k) {
+            CsvChunk& chunk = chunks[k];
+            size_t row = chunk.firstRow;
+            size_t lineNo = chunk.firstLine;
+            for (const char* line = chunk.begin; line < chunk.end; ++lineNo) {
+                const char* lineEnd = std::find(line, chunk.end, '\n');
+                if (isDataLine(line, lineEnd)) {
+                    Particle& p = out[row++];
+                    p.radius = 0.01f;
+                    p.mass = 1.0f;
+                    if (!parseCsvRow(line, lineEnd, fieldOf, world.originX, world.originY, p, chunk.error)) {
+                        chunk.errorLine = headerLine + 1 + lineNo; // 1-based
+                        break;
+                    }
+                    ParticleUtils::applyTypeDefaults(p, hasColor, hasTemperature);
+                }
+                line = lineEnd + 1;
+            }
+        }
+    });
+
+    for (const auto& chunk : chunks) {
+        if (chunk.errorLine) {
+            world.objects.resize(firstObject);
+            result.error = "line " + std::to_string(chunk.errorLine) + ": " + chunk.error;
+            return result;
+        }
+    }
+    result.imported = rows;
+    return result;
+}
+
+ImportResult importInitialConditions(PhysicsWorld& world, const char* path) {
+    size_t n = std::strlen(path);
+    if (n >= 4 && equalsIgnoreCase(path + n - 4, path + n, ".csv")) return importCsv(world, path);
+    return importColumnar(world, path);
+}
+
+bool exportColumnar(const PhysicsWorld& world, const char* path) {
+    FILE* f = std::fopen(path, "wb");
+    if (!f) return false;
+    const auto& objects = world.objects;
+    // Absolute coordinates, which need f64 once the origin has moved
+    const bool doublePositions = sizeof(Real) == sizeof(double) || world.originX != 0.0 || world.originY != 0.0;
+    auto putReal = [&](unsigned char* dst, double v) {
+        if (doublePositions) {
+            std::memcpy(dst, &v, sizeof(v));
+        } else {
+            float f = static_cast<float>(v);
+            std::memcpy(dst, &f, sizeof(f));
+        }
+    };
+    ColumnarHeader header = {};
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.count = objects.size();
+    header.columns = kAllColumns;
+    header.flags = doublePositions ? static_cast<uint32_t>(IcDoublePositions) : 0u;
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+    size_t offset = sizeof(header);
+
+    // One column at a time through a scratch buffer
+    std::vector<unsigned char> buffer;
+    for (uint32_t c = 0; c < IcColumnCount && ok; ++c) {
+        uint32_t bit = 1u << c;
+        size_t width = columnWidth(bit, doublePositions);
+        buffer.assign(align8(offset) - offset + objects.size() * width, 0);
+        unsigned char* dst = buffer.data() + (align8(offset) - offset);
+        for (size_t i = 0; i < objects.size(); ++i, dst += width) {
+            const Particle& p = objects[i];
+            switch (bit) {
+                case IcX: putReal(dst, world.originX + static_cast<double>(p.x)); break;
+                case IcY: putReal(dst, world.originY + static_cast<double>(p.y)); break;
+                case IcVX: putReal(dst, static_cast<double>(p.vx)); break;
+                case IcVY: putReal(dst, static_cast<double>(p.vy)); break;
+                case IcRadius: std::memcpy(dst, &p.radius, width); break;
+                case IcMass: std::memcpy(dst, &p.mass, width); break;
+                case IcType: *dst = static_cast<unsigned char>(p.type); break;
+                case IcColor: std::memcpy(dst, &p.color, width); break;
+                case IcTemperature: std::memcpy(dst, &p.temperature, width); break;
+            }
+        }
+        ok = buffer.empty() || std::fwrite(buffer.data(), buffer.size(), 1, f) == 1;
+        offset += buffer.size();
+    }
+    return std::fclose(f) == 0 && ok;
+}
@@ -0,0 +1,109 @@
+#include "line_batch.hpp"
+#include "render_utils.hpp"
+#include <cstddef>
+#include <algorithm>
+
+static const char* lineVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aPos;
+    layout (location = 1) in vec4 aColor;
+    uniform vec4 view; // camera centre, zoom
+    out vec4 vColor;
+    void main() {
+        vColor = aColor;
+        gl_Position = vec4((aPos - view.xy) * view.zw, 0.0, 1.0);
+    }
+)";
+
+static const char* lineFragmentShaderSource = R"(
+    #version 330 core
+    in vec4 vColor;
+    out vec4 FragColor;
+    void main() {
+        FragColor = vColor;
+    }
+)";
+
+bool LineBatch::init() {
+    program = createShaderProgram(lineVertexShaderSource, lineFragmentShaderSource);
+    viewLoc = glGetUniformLocation(program, "view");
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    stream.init();
+    return program != 0;
+}
+
+void LineBatch::destroy() {
+    stream.destroy();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    vao = program = 0;
+}
+
+std::vector<LineBatch::Vertex>& LineBatch::bucketFor(float width) {
+    for (auto& b : buckets) {
+        if (b.width == width) return b.vertices;
+    }
+    buckets.push_back({width, {}});
+    return buckets.back().vertices;
+}
+
+void LineBatch::setView(const Camera2D& camera) {
+    camera.viewUniform(view);
+}
+
+void LineBatch::addLine(float x0, float y0, float x1, float y1, const Color3& c, float alpha, float width) {
+    auto& v = bucketFor(width);
+    v.push_back({x0, y0, c.r, c.g, c.b, alpha});
+    v.push_back({x1, y1, c.r, c.g, c.b, alpha});
+}
+
+void LineBatch::addLine(float x0, float y0, const Color3& c0, float a0,
+                        float x1, float y1, const Color3& c1, float a1, float width) {
+    auto& v = bucketFor(width);
+    v.push_back({x0, y0, c0.r, c0.g, c0.b, a0});
+    v.push_back({x1, y1, c1.r, c1.g, c1.b, a1});
+}
+
+size_t LineBatch::segmentCount() const {
+    size_t n = 0;
+    for (const auto& b : buckets) n += b.vertices.size() / 2;
+    return n;
+}
+
+void LineBatch::flush() {
+    size_t total = 0;
+    for (const auto& b : buckets) total += b.vertices.size();
+    if (total == 0 || !program) return;
+
+    // All widths go into one upload; each bucket is a sub-range of it
+    Vertex* out = static_cast<Vertex*>(stream.map(total * sizeof(Vertex)));
+    size_t first = 0;
+    for (const auto& b : buckets) {
+        std::copy(b.vertices.begin(), b.vertices.end(), out + first);
+        first += b.vertices.size();
+    }
+    size_t byteOffset = stream.unmap();
+
+    glUseProgram(program);
+    glUniform4fv(viewLoc, 1, view);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(byteOffset + offsetof(Vertex, x)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(byteOffset + offsetof(Vertex, r)));
+    first = 0;
+    for (auto& b : buckets) {
+        if (!b.vertices.empty()) {
+            glLineWidth(b.width);
+            glDrawArrays(GL_LINES, static_cast<GLint>(first), static_cast<GLsizei>(b.vertices.size()));
+            first += b.vertices.size();
+        }
+        b.vertices.clear();
+    }
+    glLineWidth(1.0f);
+    glBindVertexArray(0);
+    stream.fence();
+}
@@ -2,8 +2,13 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <vector>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include "physics.hpp"
+#include "initial_conditions.hpp"
+#include "domain.hpp"
 #include "grid.hpp"
 #include "render_utils.hpp"
 #include "render_loop.hpp"
@@ -20,8 +25,9 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 const char* vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec2 aPos;
+    uniform vec4 view; // camera centre, zoom
     void main() {
-        gl_Position = vec4(aPos, 0.0, 1.0);
+        gl_Position = vec4((aPos - view.xy) * view.zw, 0.0, 1.0);
         gl_PointSize = 24.0;
     }
  )";
@@ -43,33 +49,24 @@ const char* axisFragmentShaderSource = R"(
     }
  )";
 
-// Add a fragment shader for square points
-const char* pointFragmentShaderSource = R"(
-    #version 330 core
-    out vec4 FragColor;
-    uniform vec3 color;
-    void main() {
-        FragColor = vec4(color, 1.0);
-    }
- )";
-
 // Utility and VAO/VBO functions moved to render_utils.cpp/hpp
 
 // Mouse callback for spawning/removing objects
 PhysicsWorld* gWorld = nullptr;
+Camera2D* gCamera = nullptr;
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action == GLFW_PRESS) {
         if (key == GLFW_KEY_ESCAPE) {
             glfwSetWindowShouldClose(window, GLFW_TRUE);
         }
-        if (key == GLFW_KEY_M && gWorld) {
+        if (key == GLFW_KEY_M && gWorld && gCamera) {
             double xpos, ypos;
             int width, height;
             glfwGetCursorPos(window, &xpos, &ypos);
             glfwGetWindowSize(window, &width, &height);
-            float x = (float)((xpos / width) * 2.0 - 1.0);
-            float y = (float)(1.0 - (ypos / height) * 2.0);
+            float x, y;
+            gCamera->screenToWorld(xpos, ypos, width, height, x, y);
             float mass = 1.0f;
             float radius = 0.02f;
             gWorld->addObject({x, y, 0.0f, 0.0f, radius, mass, 0.0f, false});
@@ -77,7 +74,7 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         if (key == GLFW_KEY_BACKSPACE && gWorld) {
             for (int i = static_cast<int>(gWorld->objects.size()) - 1; i >= 0; --i) {
                 if (!gWorld->objects[i].isStatic) {
-                    gWorld->objects.erase(gWorld->objects.begin() + i);
+                    gWorld->removeObject(i);
                     break;
                 }
             }
@@ -92,7 +89,30 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 
 // Main render loosrc/grid.cpp src/main.cpp src/physics.cpp src/render_loop.cpp src/render_utils.cppp moved to render_loop.cpp/hpp
 
-int main() {
+int main(int argc, char** argv) {
+    // Headless decomposed run: PhysicsEngine --ranks N [--steps S] [--dt T]
+    // bodies.phic|bodies.csv [out.phic]
+    if (argc > 1 && std::strcmp(argv[1], "--ranks") == 0) {
+        int ranks = argc > 2 ? std::atoi(argv[2]) : 0;
+        uint64_t steps = 1000;
+        float dt = 1.0f / 60.0f;
+        const char* paths[2] = {nullptr, nullptr};
+        int pathCount = 0;
+        for (int i = 3; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+                steps = std::strtoull(argv[++i], nullptr, 10);
+            } else if (std::strcmp(argv[i], "--dt") == 0 && i + 1 < argc) {
+                dt = std::strtof(argv[++i], nullptr);
+            } else if (pathCount < 2) {
+                paths[pathCount++] = argv[i];
+            }
+        }
+        if (ranks < 1 || !paths[0]) {
+            std::cerr << "Usage: " << argv[0] << " --ranks N [--steps S] [--dt T] input [output.phic]\n";
+            return 1;
+        }
+        return runDecomposed(ranks, steps, dt, paths[0], paths[1]);
+    }
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW\n";
         return -1;
@@ -153,8 +173,16 @@ int main() {
     setupVAOandVBO(axisVAO, axisVBO, axisVertices);
     GLuint axisProgram = createShaderProgram(vertexShaderSource, axisFragmentShaderSource);
 
-    // Points (for objects)
-    GLuint pointProgram = createShaderProgram(vertexShaderSource, pointFragmentShaderSource);
+    // Objects (instanced quads)
+    ParticleRenderer particleRenderer;
+    if (!particleRenderer.init()) {
+        std::cerr << "Failed to create particle renderer\n";
+    }
+    // Overlay lines (field arrows, spin markers, trails)
+    LineBatch lineBatch;
+    if (!lineBatch.init()) {
+        std::cerr << "Failed to create line renderer\n";
+    }
 
     // Grid renderer
     GridRenderer gridRenderer;
@@ -163,6 +191,17 @@ int main() {
     PhysicsWorld world;
     world.gravity = 0.0f;
     gWorld = &world;
+    // Optional initial conditions: PhysicsEngine [bodies.phic | bodies.csv]
+    if (argc > 1) {
+        ImportResult loaded = importInitialConditions(world, argv[1]);
+        if (loaded) {
+            std::cout << "Loaded " << loaded.imported << " bodies from " << argv[1] << std::endl;
+        } else {
+            std::cerr << "Failed to load " << argv[1] << ": " << loaded.error << "\n";
+        }
+    }
+    Camera2D camera;
+    gCamera = &camera;
     // Do not override ImGui's input callbacks; use input capture flags in main loop
 
     // Set default color for axes (red)
@@ -172,6 +211,9 @@ int main() {
 
     // UI state
     UIState uiState;
+    uiState.treeTheta = world.gravityTheta;
+    uiState.substepCap = world.maxSubsteps;
+    uiState.trailDecimation = static_cast<int>(world.trails.decimation);
 
     // Main loop with ImGui and custom rendering
     while (!glfwWindowShouldClose(window)) {
@@ -180,11 +222,50 @@ int main() {
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
+        // Quality knobs for this frame: the user's settings, degraded by the
+        // controller if the last frames ran over budget
+        QualitySettings preferredQuality = uiState.preferredQuality();
+        uiState.applied = uiState.quality.apply(preferredQuality);
+        world.gravityTheta = uiState.applied.treeTheta;
+        world.maxSubsteps = uiState.applied.substepCap;
+        world.trails.decimation = uiState.applied.trailDecimation;
+
         // Physics step always runs if not paused, scaled by UI timeScale
         ImGuiIO& io = ImGui::GetIO();
+        double stepMs = -1.0;
         if (!uiState.paused && !world.objects.empty()) {
             world.gravity = uiState.gravity;
+            auto stepStart = std::chrono::steady_clock::now();
             world.step((1.0f / 60.0f) * uiState.timeScale); // Scaled timestep
+            stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+        }
+        // Keep the view on the same place when the world origin is rebased
+        static double viewOriginX = world.originX, viewOriginY = world.originY;
+        camera.centerX -= static_cast<float>(world.originX - viewOriginX);
+        camera.centerY -= static_cast<float>(world.originY - viewOriginY);
+        viewOriginX = world.originX;
+        viewOriginY = world.originY;
+
+        // Camera: wheel zooms about the cursor, right-drag pans, Home resets
+        {
+            double xpos, ypos;
+            int width, height;
+            glfwGetCursorPos(window, &xpos, &ypos);
+            glfwGetWindowSize(window, &width, &height);
+            static double prevX = xpos, prevY = ypos;
+            if (!io.WantCaptureMouse && width > 0 && height > 0) {
+                if (io.MouseWheel != 0.0f) {
+                    camera.zoomAt(xpos, ypos, width, height, std::pow(1.1f, io.MouseWheel));
+                }
+                if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+                    camera.panPixels(xpos - prevX, ypos - prevY, width, height);
+                }
+            }
+            prevX = xpos;
+            prevY = ypos;
+            if (!io.WantCaptureKeyboard && glfwGetKey(window, GLFW_KEY_HOME) == GLFW_PRESS) {
+                camera.reset();
+            }
         }
 
         // Custom keyboard input (add/remove objects, pause, etc.)
@@ -195,8 +276,8 @@ int main() {
                 int width, height;
                 glfwGetCursorPos(window, &xpos, &ypos);
                 glfwGetWindowSize(window, &width, &height);
-                float x = (float)((xpos / width) * 2.0 - 1.0);
-                float y = (float)(1.0 - (ypos / height) * 2.0);
+                float x, y;
+                camera.screenToWorld(xpos, ypos, width, height, x, y);
                 float mass = 1.0f;
                 float radius = 0.02f;
                 gWorld->addObject({x, y, 0.0f, 0.0f, radius, mass, 0.0f, false});
@@ -205,7 +286,7 @@ int main() {
             if (glfwGetKey(window, GLFW_KEY_BACKSPACE) == GLFW_PRESS) {
                 for (int i = static_cast<int>(gWorld->objects.size()) - 1; i >= 0; --i) {
                     if (!gWorld->objects[i].isStatic) {
-                        gWorld->objects.erase(gWorld->objects.begin() + i);
+                        gWorld->removeObject(i);
                         break;
                     }
                 }
@@ -222,12 +303,17 @@ int main() {
                 glfwSetWindowShouldClose(window, GLFW_TRUE);
             }
         }
+        gridRenderer.setFieldResolution(uiState.applied.fieldResolution);
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        renderLoop(window, gridProgram, gridVAO, gridVertices.size() / 2, axisProgram, axisVAO, axisVertices.size() / 2, gridRenderer, world, pointProgram);
+        particleRenderer.tintSleeping = uiState.showSleeping;
+        auto viewStart = std::chrono::steady_clock::now();
+        renderLoop(window, gridProgram, gridVAO, gridVertices.size() / 2, axisProgram, axisVAO, axisVertices.size() / 2, gridRenderer, particleRenderer, lineBatch, camera, world);
 
         // Draw ImGui UI (just widgets, not rendering)
         drawUI(uiState, window, &world);
+        double viewMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - viewStart).count();
+        uiState.quality.update(preferredQuality, stepMs, viewMs);
 
         // --- Ensure OpenGL state for ImGui ---
         int fbWidth, fbHeight;
@@ -262,7 +348,8 @@ int main() {
     glDeleteBuffers(1, &axisVBO);
     glDeleteProgram(gridProgram);
     glDeleteProgram(axisProgram);
-    glDeleteProgram(pointProgram);
+    particleRenderer.destroy();
+    lineBatch.destroy();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
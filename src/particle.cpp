@@ -1,22 +1,140 @@
 #include "particle.hpp"
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 // Trail implementation
-void Trail::addPoint(float x, float y) {
-    positions.push_back(x);
-    positions.push_back(y);
-    if (positions.size() > maxPoints * 2) {
-        positions.erase(positions.begin(), positions.begin() + 2);
+void Trail::ranges(uint32_t& first0, uint32_t& count0, uint32_t& first1, uint32_t& count1) const {
+    uint32_t start = (head + capacity - count) % std::max(capacity, 1u);
+    first0 = offset + start;
+    count0 = std::min(count, capacity - start);
+    first1 = offset;
+    count1 = count - count0;
+}
+
+bool Trail::mayTouch(float minX, float minY, float maxX, float maxY) const {
+    float bx0 = std::min(lapBox[0], prevLapBox[0]), by0 = std::min(lapBox[1], prevLapBox[1]);
+    float bx1 = std::max(lapBox[2], prevLapBox[2]), by1 = std::max(lapBox[3], prevLapBox[3]);
+    return bx0 <= maxX && bx1 >= minX && by0 <= maxY && by1 >= minY;
+}
+
+void Trail::resetBounds() {
+    // Empty boxes: min above max, so they never touch anything
+    const float big = std::numeric_limits<float>::max();
+    float empty[4] = {big, big, -big, -big};
+    std::copy(empty, empty + 4, lapBox);
+    std::copy(empty, empty + 4, prevLapBox);
+}
+
+int TrailPool::allocate(uint32_t capacity) {
+    int handle = -1;
+    // Exact size only, so a short trail never holds on to a long ring
+    for (size_t k = 0; k < freeList.size(); ++k) {
+        if (trails[freeList[k]].capacity == capacity) {
+            handle = freeList[k];
+            freeList[k] = freeList.back();
+            freeList.pop_back();
+            break;
+        }
+    }
+    if (handle < 0) {
+        Trail t;
+        t.offset = static_cast<uint32_t>(points.size() / 2);
+        t.capacity = capacity;
+        points.resize(points.size() + capacity * 2, 0.0f);
+        trails.push_back(t);
+        handle = static_cast<int>(trails.size()) - 1;
     }
+    Trail& t = trails[handle];
+    t.head = 0;
+    t.count = 0;
+    t.tick = 0;
+    t.resetBounds();
+    t.inUse = true;
+    ++live;
+    return handle;
+}
+
+void TrailPool::release(int handle) {
+    if (!valid(handle)) return;
+    trails[handle].inUse = false;
+    trails[handle].count = 0;
+    freeList.push_back(handle);
+    --live;
+}
+
+void TrailPool::addPoint(int handle, float x, float y) {
+    Trail& t = trails[handle];
+    if (t.tick++ % std::max(decimation, 1u) != 0) return;
+    size_t slot = (t.offset + t.head) * 2;
+    points[slot] = x;
+    points[slot + 1] = y;
+    t.lapBox[0] = std::min(t.lapBox[0], x);
+    t.lapBox[1] = std::min(t.lapBox[1], y);
+    t.lapBox[2] = std::max(t.lapBox[2], x);
+    t.lapBox[3] = std::max(t.lapBox[3], y);
+    t.head = (t.head + 1 == t.capacity) ? 0 : t.head + 1;
+    if (t.head == 0) {
+        // The next lap overwrites the oldest points, so the finished lap's box covers them
+        std::copy(t.lapBox, t.lapBox + 4, t.prevLapBox);
+        const float big = std::numeric_limits<float>::max();
+        t.lapBox[0] = t.lapBox[1] = big;
+        t.lapBox[2] = t.lapBox[3] = -big;
+    }
+    if (t.count < t.capacity) ++t.count;
+}
+
+void TrailPool::clear(int handle) {
+    if (!valid(handle)) return;
+    trails[handle].head = 0;
+    trails[handle].count = 0;
+    trails[handle].resetBounds();
 }
 
-void Trail::update() {
-    // Fade old points (could be used for alpha blending)
+void TrailPool::clearAll() {
+    points.clear();
+    trails.clear();
+    freeList.clear();
+    live = 0;
 }
 
-void Trail::clear() {
-    positions.clear();
+size_t TrailPool::memoryUsage() const {
+    return points.capacity() * sizeof(float) + trails.capacity() * sizeof(Trail)
+         + freeList.capacity() * sizeof(int) + claimed.capacity();
+}
+
+void TrailPool::translate(float dx, float dy) {
+    for (size_t i = 0; i + 1 < points.size(); i += 2) {
+        points[i] -= dx;
+        points[i + 1] -= dy;
+    }
+    for (auto& t : trails) {
+        for (float* box : {t.lapBox, t.prevLapBox}) {
+            box[0] -= dx; box[2] -= dx;
+            box[1] -= dy; box[3] -= dy;
+        }
+    }
+}
+
+void TrailPool::sync(std::vector<Particle>& objects) {
+    claimed.assign(trails.size(), 0);
+    for (auto& obj : objects) {
+        if (obj.trailLength == 0) {
+            obj.trail = -1;
+            continue;
+        }
+        // A ring of another length (trailLength changed) is released below
+        if (valid(obj.trail) && !claimed[obj.trail] && trails[obj.trail].capacity == obj.trailLength) {
+            claimed[obj.trail] = 1;
+            continue;
+        }
+        obj.trail = allocate(obj.trailLength);
+        if (static_cast<size_t>(obj.trail) >= claimed.size()) claimed.resize(obj.trail + 1, 0);
+        claimed[obj.trail] = 1;
+    }
+    for (size_t i = 0; i < trails.size(); ++i) {
+        if (trails[i].inUse && !claimed[i]) release(static_cast<int>(i));
+    }
 }
 
 // Existing color function
@@ -115,6 +233,51 @@ Color3 ParticleUtils::getTemperatureColor(float temp) {
     }
 }
 
+void ParticleUtils::applyTypeDefaults(Particle& p, bool hasColor, bool hasTemperature) {
+    Color3 color = p.color;
+    switch (p.type) {
+        case ObjectType::Star:
+            if (!hasTemperature) p.temperature = 5778.0f;
+            p.emitsLight = true;
+            p.luminosity = p.mass * 0.1f;
+            color = ParticleUtils::getTemperatureColor(p.temperature);
+            break;
+        case ObjectType::BlackHole:
+            p.eventHorizon = p.schwarzschildRadius() * 2.0f;
+            p.absorption = 1.0f;
+            p.density = 1000.0f;
+            color = {0.05f, 0.05f, 0.1f};
+            break;
+        case ObjectType::NeutronStar:
+            p.emitsLight = true;
+            p.luminosity = 0.5f;
+            p.magneticField = 100.0f;
+            color = {0.8f, 0.9f, 1.0f};
+            break;
+        case ObjectType::WhiteDwarf:
+            p.emitsLight = true;
+            p.luminosity = 0.2f;
+            color = {0.9f, 0.9f, 1.0f};
+            break;
+        case ObjectType::GasGiant:
+            color = {0.8f, 0.7f, 0.5f};
+            break;
+        case ObjectType::Planet:
+        case ObjectType::RockyPlanet:
+            color = {0.5f, 0.5f, 0.8f};
+            break;
+        case ObjectType::Asteroid:
+            color = {0.6f, 0.5f, 0.4f};
+            break;
+        case ObjectType::Comet:
+            color = {0.7f, 0.8f, 0.9f};
+            break;
+        default:
+            break;
+    }
+    if (!hasColor) p.color = color;
+}
+
 // NEW: Create preset star
 Particle ParticleUtils::createStar(float x, float y, float mass, float temp) {
     Particle star;
@@ -188,9 +351,8 @@ Particle ParticleUtils::createComet(float x, float y, float vx, float vy) {
     comet.spin = 2.0f;
     comet.density = 0.5f;
     
-    // Create trail
-    comet.trail = std::make_shared<Trail>();
-    comet.trail->maxPoints = 150;
+    // Trail ring is allocated by the world's TrailPool
+    comet.trailLength = 150;
     
     return comet;
 }
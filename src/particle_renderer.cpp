@@ -0,0 +1,162 @@
+#include "particle_renderer.hpp"
+#include "render_utils.hpp"
+#include "physics.hpp"
+#include "particle.hpp"
+#include <cstddef>
+
+// Layer sizes below mirror the old per-type glPointSize passes, as multiples
+// of the core diameter (obj.radius * 600 px).
+static const char* particleVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aCorner;
+    layout (location = 1) in vec4 aPosSize;   // x, y, core diameter, aux diameter
+    layout (location = 2) in vec4 aColorType; // r, g, b, type
+    uniform vec2 viewport;
+    uniform vec4 view;     // camera centre, zoom
+    out vec2 vLocal;
+    flat out vec3 vColor;
+    flat out vec3 vParams; // core diameter, aux diameter, type
+    const int MERGED = 1;
+    const int BLACK_HOLE = 2;
+    const int STAR = 3;
+    const int PLANET = 4;
+    const int ASTEROID = 5;
+    void main() {
+        int type = int(aColorType.w + 0.5);
+        float size = max(aPosSize.z * view.z, 1.0);
+        float aux = aPosSize.w * view.z;
+        float extent = size;
+        if (type == BLACK_HOLE) extent = max(size, aux);
+        else if (type == STAR) extent = size * 2.0;
+        else if (type == PLANET) extent = size * 1.5;
+        else if (type == MERGED) extent = size * 1.3;
+        else if (type == ASTEROID) extent = max(size * 0.8, 1.0);
+        extent += 1.0;
+        vLocal = aCorner * extent * 0.5;
+        vColor = aColorType.rgb;
+        vParams = vec3(size, aux, float(type));
+        vec2 centre = (aPosSize.xy - view.xy) * view.zw;
+        gl_Position = vec4(centre + aCorner * extent / viewport, 0.0, 1.0);
+    }
+)";
+
+static const char* particleFragmentShaderSource = R"(
+    #version 330 core
+    in vec2 vLocal;
+    flat in vec3 vColor;
+    flat in vec3 vParams;
+    out vec4 FragColor;
+    const int MERGED = 1;
+    const int BLACK_HOLE = 2;
+    const int STAR = 3;
+    const int PLANET = 4;
+    const int ASTEROID = 5;
+    void main() {
+        float d = 2.0 * length(vLocal) - 1.0; // diameter through this pixel, 1px slack
+        float size = vParams.x;
+        int type = int(vParams.z + 0.5);
+        vec3 c;
+        if (type == BLACK_HOLE) {
+            // Dark core inside the event-horizon ring
+            if (d <= size) c = vec3(0.2);
+            else if (d <= vParams.y) c = vec3(0.1);
+            else discard;
+        } else if (type == STAR) {
+            // Core, bright corona, outer glow
+            if (d <= size) c = vColor;
+            else if (d <= size * 1.2) c = vec3(1.0, 1.0, 0.6);
+            else if (d <= size * 2.0) c = vColor;
+            else discard;
+        } else if (type == PLANET) {
+            // Grey halo
+            if (d <= size) c = vColor;
+            else if (d <= size * 1.5) c = vec3(0.7);
+            else discard;
+        } else if (type == ASTEROID) {
+            if (d <= max(size * 0.8, 1.0)) c = vColor * vec3(0.7, 0.6, 0.5);
+            else discard;
+        } else if (type == MERGED) {
+            // Cyan body with a white outline
+            if (d <= size) c = vec3(0.2, 0.8, 1.0);
+            else if (d <= size * 1.3) c = vec3(1.0);
+            else discard;
+        } else {
+            if (d <= size) c = vColor;
+            else discard;
+        }
+        FragColor = vec4(c, 1.0);
+    }
+)";
+
+bool ParticleRenderer::init() {
+    program = createShaderProgram(particleVertexShaderSource, particleFragmentShaderSource);
+    viewportLoc = glGetUniformLocation(program, "viewport");
+    viewLoc = glGetUniformLocation(program, "view");
+
+    const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+
+    instances.init();
+    return program != 0;
+}
+
+void ParticleRenderer::destroy() {
+    instances.destroy();
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    quadVBO = vao = program = 0;
+}
+
+void ParticleRenderer::draw(const PhysicsWorld& world, const std::vector<size_t>& visible,
+                            const Camera2D& camera, int fbWidth, int fbHeight) {
+    const auto& objects = world.objects;
+    size_t count = visible.size();
+    if (count == 0 || !program) return;
+
+    Instance* out = static_cast<Instance*>(instances.map(count * sizeof(Instance)));
+    for (size_t i = 0; i < count; ++i) {
+        const auto& obj = objects[visible[i]];
+        Instance& inst = out[i];
+        inst.x = obj.x;
+        inst.y = obj.y;
+        inst.size = obj.radius * 600.0f;
+        inst.aux = obj.eventHorizon * 1200.0f;
+        inst.r = obj.color.r;
+        inst.g = obj.color.g;
+        inst.b = obj.color.b;
+        if (tintSleeping && obj.sleeping) {
+            inst.r = inst.r * 0.4f + 0.10f;
+            inst.g = inst.g * 0.4f + 0.15f;
+            inst.b = inst.b * 0.4f + 0.35f;
+        }
+        inst.type = static_cast<float>(obj.type);
+    }
+    size_t byteOffset = instances.unmap();
+
+    glUseProgram(program);
+    glUniform2f(viewportLoc, static_cast<float>(fbWidth), static_cast<float>(fbHeight));
+    float view[4];
+    camera.viewUniform(view);
+    glUniform4fv(viewLoc, 1, view);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer());
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          (void*)(byteOffset + offsetof(Instance, x)));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          (void*)(byteOffset + offsetof(Instance, r)));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+    glBindVertexArray(0);
+    instances.fence();
+}
@@ -1,10 +1,13 @@
 #include "physics.hpp"
+#include "thread_pool.hpp"
+#include "fast_math.hpp"
 #include <cmath>
+#include <cstdio>
 #include <algorithm>
-#include <random>
-
-// Universal gravitational constant
-constexpr float G = 0.01f;
+#include <array>
+#include <limits>
+#include <mutex>
+#include <utility>
 
 float PhysicsWorld::totalKineticEnergy() const {
     float ke = 0.0f;
@@ -26,17 +29,77 @@ void PhysicsWorld::totalMomentum(float& px, float& py) const {
     }
 }
 
+ThreadPool& PhysicsWorld::pool() const {
+    return threadPool ? *threadPool : ThreadPool::shared();
+}
+
+template <class Term>
+double PhysicsWorld::parallelSum(size_t count, size_t block, Term term) const {
+    if (!deterministic) {
+        // One partial per pool chunk, added in whatever order chunks finish
+        double total = 0.0;
+        std::mutex totalMutex;
+        pool().parallelFor(count, [&](size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) sum += term(i);
+            std::lock_guard<std::mutex> lock(totalMutex);
+            total += sum;
+        }, block);
+        return total;
+    }
+    size_t blocks = (count + block - 1) / block;
+    std::vector<double> partial(blocks, 0.0);
+    pool().parallelFor(blocks, [&](size_t b0, size_t b1) {
+        for (size_t b = b0; b < b1; ++b) {
+            double sum = 0.0;
+            for (size_t i = b * block; i < std::min(count, (b + 1) * block); ++i) sum += term(i);
+            partial[b] = sum;
+        }
+    });
+    double total = 0.0;
+    for (double p : partial) total += p;
+    return total;
+}
+
 float PhysicsWorld::totalPotentialEnergy() const {
-    float pe = 0.0f;
-    for (size_t i = 0; i < objects.size(); ++i) {
+    const float g = static_cast<float>(G);
+    // Row i sums its pairs with j > i; rows go to the pool
+    double pe = parallelSum(objects.size(), 32, [&](size_t i) {
+        float row = 0.0f;
         for (size_t j = i + 1; j < objects.size(); ++j) {
             float dx = objects[j].x - objects[i].x;
             float dy = objects[j].y - objects[i].y;
             float dist = std::sqrt(dx * dx + dy * dy);
-            pe -= G * objects[i].mass * objects[j].mass / std::max(dist, 1e-4f);
+            row -= g * objects[i].mass * objects[j].mass / std::max(dist, 1e-4f);
+        }
+        return static_cast<double>(row);
+    });
+    return static_cast<float>(pe);
+}
+
+uint64_t PhysicsWorld::stateHash() const {
+    // FNV-1a over the exact bits of the dynamic state
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&h](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t k = 0; k < size; ++k) {
+            h ^= bytes[k];
+            h *= 0x100000001b3ull;
         }
+    };
+    mix(&originX, sizeof(originX));
+    mix(&originY, sizeof(originY));
+    for (const auto& obj : objects) {
+        const Real pos[4] = {obj.x, obj.y, obj.vx, obj.vy};
+        const float props[8] = {obj.radius, obj.mass, obj.spinAngle, obj.temperature, obj.age, obj.sleepTime,
+                                obj.sleepPullX, obj.sleepPullY};
+        mix(pos, sizeof(pos));
+        mix(props, sizeof(props));
+        mix(&obj.sleepIsland, sizeof(obj.sleepIsland));
+        const unsigned char flags[2] = {static_cast<unsigned char>(obj.type), obj.sleeping};
+        mix(flags, sizeof(flags));
     }
-    return pe;
+    return h;
 }
 
 float PhysicsWorld::totalAngularMomentum() const {
@@ -59,74 +122,522 @@ void PhysicsWorld::addObject(const PhysicsObject& obj) {
         }
     }
     objects.push_back(obj);
+    invalidateNeighbours();
+    ++revision;
+}
+
+void PhysicsWorld::removeObject(size_t index) {
+    if (index >= objects.size()) return;
+    const auto& removed = objects[index];
+    if (allowSleeping) wakeRegion(removed.x, removed.y, removed.radius);
+    objects.erase(objects.begin() + index);
+    markObjectsChanged();
+}
+
+void PhysicsWorld::clearObjects() {
+    objects.clear();
+    markObjectsChanged();
+}
+
+size_t PhysicsWorld::addObjects(Span<const PhysicsObject> batch, OverlapPolicy policy) {
+    if (batch.empty()) return 0;
+    objects.reserve(objects.size() + batch.size());
+    if (policy == OverlapPolicy::Allow) {
+        objects.insert(objects.end(), batch.begin(), batch.end());
+        invalidateNeighbours();
+        ++revision;
+        return batch.size();
+    }
+    
+    // Cells of twice the batch's mean radius. Objects bigger than a cell
+    // (existing bodies much larger than the batch, or a few large ones in
+    // it) go into a second grid with cells of twice their own mean radius,
+    // and the rare ones bigger than that too (black holes, suns) are checked
+    // from a list, so none of them blows up the cell size for the rest.
+    float meanRadius = 0.0f;
+    for (const auto& obj : batch) meanRadius += obj.radius;
+    meanRadius /= batch.size();
+    float cell = std::max(2.0f * meanRadius, 1e-4f);
+    double largeRadius = 0.0;
+    size_t largeCount = 0;
+    auto countLarge = [&](const PhysicsObject& obj) {
+        if (obj.radius <= cell) return;
+        largeRadius += obj.radius;
+        ++largeCount;
+    };
+    for (const auto& obj : objects) countLarge(obj);
+    for (const auto& obj : batch) countLarge(obj);
+    float largeCell = largeCount ? std::max(static_cast<float>(2.0 * largeRadius / largeCount), cell) : cell;
+    SpatialHashGrid grid, largeGrid;
+    grid.build({}, cell);
+    largeGrid.build({}, largeCell);
+    std::vector<size_t> huge;
+    auto track = [&](size_t i) {
+        if (objects[i].radius <= cell) grid.insert(i, objects[i].x, objects[i].y);
+        else if (objects[i].radius <= largeCell) largeGrid.insert(i, objects[i].x, objects[i].y);
+        else huge.push_back(i);
+    };
+    for (size_t i = 0; i < objects.size(); ++i) track(i);
+    
+    size_t added = 0;
+    for (const auto& obj : batch) {
+        bool overlaps = false;
+        auto test = [&](size_t j) {
+            const auto& existing = objects[j];
+            float dx = obj.x - existing.x;
+            float dy = obj.y - existing.y;
+            float minDist = obj.radius + existing.radius;
+            if ((dx * dx + dy * dy) < (minDist * minDist)) overlaps = true;
+        };
+        float reach = obj.radius + cell;
+        grid.forEachInRect(obj.x - reach, obj.y - reach, obj.x + reach, obj.y + reach, test);
+        if (!overlaps) {
+            reach = obj.radius + largeCell;
+            largeGrid.forEachInRect(obj.x - reach, obj.y - reach, obj.x + reach, obj.y + reach, test);
+        }
+        for (size_t j = 0; j < huge.size() && !overlaps; ++j) test(huge[j]);
+        if (overlaps) continue;
+        objects.push_back(obj);
+        track(objects.size() - 1);
+        ++added;
+    }
+    if (added) {
+        invalidateNeighbours();
+        ++revision;
+    }
+    return added;
+}
+
+Span<PhysicsObject> PhysicsWorld::appendObjects(size_t count) {
+    size_t first = objects.size();
+    objects.resize(first + count);
+    invalidateNeighbours();
+    ++revision;
+    return Span<PhysicsObject>(objects.data() + first, count);
+}
+
+void PhysicsWorld::reserve(size_t count) {
+    objects.reserve(count);
+    gridCellItems.reserve(count);
+    sleepSupported.reserve(count);
+    islandParent.reserve(count);
+    islandTime.reserve(count);
+    islandSupported.reserve(count);
+    islandLabel.reserve(count);
+    wokenIslands.reserve(count);
+    fieldCandidates.reserve(count);
+    fieldX.reserve(count);
+    fieldY.reserve(count);
+    fieldVX.reserve(count);
+    fieldVY.reserve(count);
+}
+
+MemoryUsage PhysicsWorld::memoryUsage() const {
+    auto bytes = [](const auto& v) { return v.capacity() * sizeof(*v.data()); };
+    MemoryUsage m;
+    m.particles = bytes(objects) + bytes(ghosts);
+    m.grid = bytes(gridCellStart) + bytes(gridCellItems) + hashGrid.memoryUsage() + ghostGrid.memoryUsage()
+           + gravityTree.memoryUsage() + bytes(neighbours) + bytes(neighbourX) + bytes(neighbourY)
+           + bytes(neighbourRadius) + bytes(gridX) + bytes(gridY);
+    m.trails = trails.memoryUsage();
+    m.history = history.memoryUsage();
+    m.fields = bytes(forceFields) + bytes(bakedFields.dvx) + bytes(bakedFields.dvy) + bytes(farField);
+    m.scratch = stepArena.capacity() + events.memoryUsage() + bytes(sleepContacts) + bytes(sleepSupported) + bytes(islandParent) + bytes(islandTime)
+              + bytes(islandSupported) + bytes(islandLabel) + bytes(wokenIslands) + bytes(fieldCandidates)
+              + bytes(fieldX) + bytes(fieldY) + bytes(fieldVX) + bytes(fieldVY) + bytes(reorderRemap);
+    return m;
+}
+
+// Batched force-field kernels. Each operates on a gathered SoA candidate set
+// with no branches in the loop body so the compiler can vectorise it; objects
+// that the radius query let through but lie just outside get zero falloff.
+// Fast: |d| and 1 / |d| from one root and one divide, and a multiply for
+// the falloff. The offset keeps a body at the centre at zero direction, as
+// 1e-6 does below.
+struct FastFieldDistance {
+    float dist, inv;
+    FastFieldDistance(float dx, float dy) {
+        float distSq = dx * dx + dy * dy;
+        inv = 1.0f / std::sqrt(distSq + 1e-12f);
+        dist = distSq * inv;
+    }
+};
+
+template <bool Fast>
+static void radialFieldKernel(const ForceField& field, size_t n, const float* xs, const float* ys,
+                              float* vxs, float* vys) {
+    const float invRadius = 1.0f / field.radius;
+    for (size_t k = 0; k < n; ++k) {
+        float dx = xs[k] - field.x;
+        float dy = ys[k] - field.y;
+        if constexpr (Fast) {
+            FastFieldDistance d(dx, dy);
+            float falloff = std::max(0.0f, 1.0f - d.dist * invRadius);
+            float scale = field.strength * falloff * 0.01f * d.inv;
+            vxs[k] += dx * scale;
+            vys[k] += dy * scale;
+            continue;
+        }
+        float dist = std::sqrt(dx * dx + dy * dy) + 1e-6f;
+        float falloff = std::max(0.0f, 1.0f - (dist / field.radius));
+        vxs[k] += (dx / dist) * field.strength * falloff * 0.01f;
+        vys[k] += (dy / dist) * field.strength * falloff * 0.01f;
+    }
+}
+
+template <bool Fast>
+static void vortexFieldKernel(const ForceField& field, size_t n, const float* xs, const float* ys,
+                              float* vxs, float* vys) {
+    const float invRadius = 1.0f / field.radius;
+    for (size_t k = 0; k < n; ++k) {
+        float dx = xs[k] - field.x;
+        float dy = ys[k] - field.y;
+        if constexpr (Fast) {
+            FastFieldDistance d(dx, dy);
+            float falloff = std::max(0.0f, 1.0f - d.dist * invRadius);
+            float scale = field.strength * falloff * d.inv;
+            // Tangential 0.01, inward 0.002
+            vxs[k] += (-dy * 0.01f - dx * 0.002f) * scale;
+            vys[k] += (dx * 0.01f - dy * 0.002f) * scale;
+            continue;
+        }
+        float dist = std::sqrt(dx * dx + dy * dy) + 1e-6f;
+        float falloff = std::max(0.0f, 1.0f - (dist / field.radius));
+        float tangentX = -dy / dist;
+        float tangentY = dx / dist;
+        vxs[k] += tangentX * field.strength * falloff * 0.01f;
+        vys[k] += tangentY * field.strength * falloff * 0.01f;
+        vxs[k] -= (dx / dist) * field.strength * falloff * 0.002f;
+        vys[k] -= (dy / dist) * field.strength * falloff * 0.002f;
+    }
+}
+
+template <bool Fast>
+static void directionalFieldKernel(const ForceField& field, size_t n, const float* xs, const float* ys,
+                                   float* vxs, float* vys) {
+    float dirX = std::cos(field.angle) * field.strength;
+    float dirY = std::sin(field.angle) * field.strength;
+    const float invRadius = 1.0f / field.radius;
+    for (size_t k = 0; k < n; ++k) {
+        float dx = xs[k] - field.x;
+        float dy = ys[k] - field.y;
+        float falloff;
+        if constexpr (Fast) {
+            falloff = std::max(0.0f, 1.0f - FastFieldDistance(dx, dy).dist * invRadius);
+        } else {
+            float dist = std::sqrt(dx * dx + dy * dy) + 1e-6f;
+            falloff = std::max(0.0f, 1.0f - (dist / field.radius));
+        }
+        vxs[k] += dirX * falloff * 0.01f;
+        vys[k] += dirY * falloff * 0.01f;
+    }
+}
+
+template <bool Fast>
+static void fieldKernel(const ForceField& field, size_t n, const float* xs, const float* ys,
+                        float* vxs, float* vys) {
+    switch (field.type) {
+        case ForceField::RADIAL: radialFieldKernel<Fast>(field, n, xs, ys, vxs, vys); break;
+        case ForceField::VORTEX: vortexFieldKernel<Fast>(field, n, xs, ys, vxs, vys); break;
+        case ForceField::DIRECTIONAL: directionalFieldKernel<Fast>(field, n, xs, ys, vxs, vys); break;
+        case ForceField::CUSTOM: break;
+    }
+}
+
+void PhysicsWorld::applyFieldKernel(const ForceField& field, size_t n, const float* xs, const float* ys,
+                                    float* vxs, float* vys, bool fast) {
+    if (fast) {
+        fieldKernel<true>(field, n, xs, ys, vxs, vys);
+    } else {
+        fieldKernel<false>(field, n, xs, ys, vxs, vys);
+    }
+}
+
+void BakedFieldGrid::sample(float x, float y, float& outX, float& outY) const {
+    outX = 0.0f; outY = 0.0f;
+    float fx = (x - x0) / spacingX;
+    float fy = (y - y0) / spacingY;
+    if (!(fx >= 0.0f && fy >= 0.0f && fx <= cols - 1 && fy <= rows - 1)) return;
+    int c = std::min(static_cast<int>(fx), cols - 2);
+    int r = std::min(static_cast<int>(fy), rows - 2);
+    float tx = fx - c;
+    float ty = fy - r;
+    size_t i00 = static_cast<size_t>(r) * cols + c;
+    size_t i10 = i00 + 1;
+    size_t i01 = i00 + cols;
+    size_t i11 = i01 + 1;
+    float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty);
+    float w01 = (1.0f - tx) * ty,          w11 = tx * ty;
+    outX = dvx[i00] * w00 + dvx[i10] * w10 + dvx[i01] * w01 + dvx[i11] * w11;
+    outY = dvy[i00] * w00 + dvy[i10] * w10 + dvy[i01] * w01 + dvy[i11] * w11;
+}
+
+void PhysicsWorld::bakeForceFieldGrid() {
+    int res = std::max(2, forceFieldBakeResolution);
+    bakedFields.cols = res;
+    bakedFields.rows = res;
+    bakedFields.x0 = left;
+    bakedFields.y0 = bottom;
+    bakedFields.spacingX = (right - left) / (res - 1);
+    bakedFields.spacingY = (top - bottom) / (res - 1);
+    
+    // The kernels add increments to whatever velocity they're given, so
+    // running them over the grid nodes with zero velocity yields the field.
+    size_t n = static_cast<size_t>(res) * res;
+    bakedFields.dvx.assign(n, 0.0f);
+    bakedFields.dvy.assign(n, 0.0f);
+    fieldX.resize(n); fieldY.resize(n);
+    for (int r = 0; r < res; ++r) {
+        for (int c = 0; c < res; ++c) {
+            fieldX[r * res + c] = bakedFields.x0 + c * bakedFields.spacingX;
+            fieldY[r * res + c] = bakedFields.y0 + r * bakedFields.spacingY;
+        }
+    }
+    bakedFieldCount = 0;
+    for (const auto& field : forceFields) {
+        if (!field.active || field.type == ForceField::CUSTOM) continue;
+        applyFieldKernel(field, n, fieldX.data(), fieldY.data(), bakedFields.dvx.data(), bakedFields.dvy.data(), fastMath);
+        ++bakedFieldCount;
+    }
+    forceFieldsDirty = false;
+    bakedFast = fastMath;
+}
+
+void PhysicsWorld::queryRadius(float x, float y, float r, std::vector<size_t>& out) const {
+    queryRadiusWithin(x, y, r, 0.0f, out);
+}
+
+void PhysicsWorld::queryRadiusWithin(float x, float y, float r, float slack, std::vector<size_t>& out) const {
+    out.clear();
+    float rSq = r * r;
+    float reach = r + slack;
+    if (openBoundary) {
+        hashGrid.forEachInRect(x - reach, y - reach, x + reach, y + reach, [&](size_t i) {
+            float dx = objects[i].x - x;
+            float dy = objects[i].y - y;
+            if (dx * dx + dy * dy <= rSq) out.push_back(i);
+        });
+        return;
+    }
+    if (gridCellStart.empty()) return;
+    int colMin = std::max(0, std::min(gridCols - 1, static_cast<int>((x - reach - left) / cellWidth)));
+    int colMax = std::max(0, std::min(gridCols - 1, static_cast<int>((x + reach - left) / cellWidth)));
+    int rowMin = std::max(0, std::min(gridRows - 1, static_cast<int>((y - reach - bottom) / cellHeight)));
+    int rowMax = std::max(0, std::min(gridRows - 1, static_cast<int>((y + reach - bottom) / cellHeight)));
+    for (int row = rowMin; row <= rowMax; ++row) {
+        for (int col = colMin; col <= colMax; ++col) {
+            for (size_t i : gridCell(row, col)) {
+                float dx = objects[i].x - x;
+                float dy = objects[i].y - y;
+                if (dx * dx + dy * dy <= rSq) out.push_back(i);
+            }
+        }
+    }
+}
+
+void PhysicsWorld::queryRect(float minX, float minY, float maxX, float maxY, float margin, std::vector<size_t>& out) const {
+    out.clear();
+    minX -= margin; minY -= margin;
+    maxX += margin; maxY += margin;
+    if (openBoundary) {
+        hashGrid.forEachInRect(minX, minY, maxX, maxY, [&](size_t i) {
+            const auto& obj = objects[i];
+            if (obj.x >= minX && obj.x <= maxX && obj.y >= minY && obj.y <= maxY) out.push_back(i);
+        });
+        return;
+    }
+    if (gridCellStart.empty()) return;
+    // Objects outside the bounds live in the edge cells, so clamp rather than reject
+    int colMin = std::max(0, std::min(gridCols - 1, static_cast<int>(std::floor((minX - left) / cellWidth))));
+    int colMax = std::max(0, std::min(gridCols - 1, static_cast<int>(std::floor((maxX - left) / cellWidth))));
+    int rowMin = std::max(0, std::min(gridRows - 1, static_cast<int>(std::floor((minY - bottom) / cellHeight))));
+    int rowMax = std::max(0, std::min(gridRows - 1, static_cast<int>(std::floor((maxY - bottom) / cellHeight))));
+    for (int row = rowMin; row <= rowMax; ++row) {
+        for (int col = colMin; col <= colMax; ++col) {
+            for (size_t i : gridCell(row, col)) {
+                const auto& obj = objects[i];
+                if (obj.x >= minX && obj.x <= maxX && obj.y >= minY && obj.y <= maxY) out.push_back(i);
+            }
+        }
+    }
 }
 
 void PhysicsWorld::applyForceFields() {
-    for (auto& field : forceFields) {
-        if (!field.active) continue;
-        
-        for (auto& obj : objects) {
-            if (obj.isStatic) continue;
-            
-            float dx = obj.x - field.x;
-            float dy = obj.y - field.y;
-            float distSq = dx * dx + dy * dy;
-            float dist = std::sqrt(distSq) + 1e-6f;
-            
-            if (dist > field.radius) continue;
-            
-            float falloff = 1.0f - (dist / field.radius);
-            
-            switch (field.type) {
-                case ForceField::RADIAL: {
-                    float fx = (dx / dist) * field.strength * falloff;
-                    float fy = (dy / dist) * field.strength * falloff;
-                    obj.vx += fx * 0.01f;
-                    obj.vy += fy * 0.01f;
-                    break;
+    if (bakeForceFields) {
+        int res = std::max(2, forceFieldBakeResolution);
+        if (forceFieldsDirty || bakedFast != fastMath || bakedFields.cols != res || bakedFields.x0 != left
+            || bakedFields.y0 != bottom
+            || bakedFields.spacingX != (right - left) / (res - 1)
+            || bakedFields.spacingY != (top - bottom) / (res - 1)) {
+            bakeForceFieldGrid();
+        }
+        if (bakedFieldCount > 0) {
+            fieldCandidates.clear();
+            for (size_t i = 0; i < objects.size(); ++i) {
+                auto& obj = objects[i];
+                if (obj.isStatic) continue;
+                // With open boundaries, bodies past the baked box get the exact fields
+                if (openBoundary && (obj.x < left || obj.x > right || obj.y < bottom || obj.y > top)) {
+                    fieldCandidates.push_back(i);
+                    continue;
                 }
-                case ForceField::VORTEX: {
-                    float tangentX = -dy / dist;
-                    float tangentY = dx / dist;
-                    obj.vx += tangentX * field.strength * falloff * 0.01f;
-                    obj.vy += tangentY * field.strength * falloff * 0.01f;
-                    obj.vx -= (dx / dist) * field.strength * falloff * 0.002f;
-                    obj.vy -= (dy / dist) * field.strength * falloff * 0.002f;
-                    break;
+                float dvx, dvy;
+                bakedFields.sample(obj.x, obj.y, dvx, dvy);
+                if (obj.sleeping) {
+                    if (dvx == 0.0f && dvy == 0.0f) continue;
+                    wakeObject(i);
                 }
-                case ForceField::DIRECTIONAL: {
-                    float fx = std::cos(field.angle) * field.strength * falloff;
-                    float fy = std::sin(field.angle) * field.strength * falloff;
-                    obj.vx += fx * 0.01f;
-                    obj.vy += fy * 0.01f;
-                    break;
+                obj.vx += dvx;
+                obj.vy += dvy;
+            }
+            size_t n = fieldCandidates.size();
+            if (n > 0) {
+                fieldX.resize(n); fieldY.resize(n);
+                fieldVX.resize(n); fieldVY.resize(n);
+                for (size_t k = 0; k < n; ++k) {
+                    if (objects[fieldCandidates[k]].sleeping) wakeObject(fieldCandidates[k]);
+                    const auto& obj = objects[fieldCandidates[k]];
+                    fieldX[k] = obj.x; fieldY[k] = obj.y;
+                    fieldVX[k] = obj.vx; fieldVY[k] = obj.vy;
                 }
-                case ForceField::CUSTOM: {
-                    if (field.customForce) {
-                        field.customForce(obj, dx, dy);
-                    }
-                    break;
+                for (const auto& field : forceFields) {
+                    if (!field.active || field.type == ForceField::CUSTOM) continue;
+                    applyFieldKernel(field, n, fieldX.data(), fieldY.data(), fieldVX.data(), fieldVY.data(), fastMath);
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    auto& obj = objects[fieldCandidates[k]];
+                    obj.vx = fieldVX[k];
+                    obj.vy = fieldVY[k];
                 }
             }
         }
     }
+    
+    bool anyActive = false;
+    for (const auto& field : forceFields) {
+        anyActive |= field.active && (!bakeForceFields || field.type == ForceField::CUSTOM);
+    }
+    if (!anyActive) return;
+    
+    // The grid of an earlier pass (the last collision pass, or the neighbour
+    // list build) serves while bodies have moved less than half a cell since
+    float slack = gridDrift();
+    if (slack < 0.0f) {
+        updateSpatialGrid();
+        slack = 0.0f;
+    }
+    
+    for (auto& field : forceFields) {
+        if (!field.active) continue;
+        if (bakeForceFields && field.type != ForceField::CUSTOM) continue;
+        
+        // Cull to the field's radius and gather the survivors into SoA scratch
+        queryRadiusWithin(field.x, field.y, field.radius, slack, fieldCandidates);
+        fieldCandidates.erase(std::remove_if(fieldCandidates.begin(), fieldCandidates.end(),
+                                             [&](size_t i) { return objects[i].isStatic; }),
+                              fieldCandidates.end());
+        size_t n = fieldCandidates.size();
+        if (n == 0) continue;
+        // Anything inside a field's radius is pushed, so it cannot stay asleep
+        for (size_t i : fieldCandidates) {
+            if (objects[i].sleeping) wakeObject(i);
+        }
+        
+        if (field.type == ForceField::CUSTOM && !field.customBatch) {
+            if (field.customForce) {
+                for (size_t i : fieldCandidates) {
+                    auto& obj = objects[i];
+                    field.customForce(obj, obj.x - field.x, obj.y - field.y);
+                }
+            }
+            continue;
+        }
+        
+        fieldX.resize(n); fieldY.resize(n);
+        fieldVX.resize(n); fieldVY.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            const auto& obj = objects[fieldCandidates[k]];
+            fieldX[k] = obj.x; fieldY[k] = obj.y;
+            fieldVX[k] = obj.vx; fieldVY[k] = obj.vy;
+        }
+        
+        if (field.type == ForceField::CUSTOM) {
+            field.customBatch(field, Span<const float>(fieldX), Span<const float>(fieldY),
+                              Span<float>(fieldVX), Span<float>(fieldVY));
+        } else {
+            applyFieldKernel(field, n, fieldX.data(), fieldY.data(), fieldVX.data(), fieldVY.data(), fastMath);
+        }
+        
+        for (size_t k = 0; k < n; ++k) {
+            auto& obj = objects[fieldCandidates[k]];
+            obj.vx = fieldVX[k];
+            obj.vy = fieldVY[k];
+        }
+    }
+}
+
+// Per-particle pieces of the integration phases, shared by the separate
+// passes and the fused kernel so both do exactly the same arithmetic.
+static inline void airDragParticle(PhysicsObject& obj, float coefficient, float dt) {
+    float speed = std::sqrt(obj.vx * obj.vx + obj.vy * obj.vy);
+    if (speed < 1e-6f) return;
+    
+    float dragForce = coefficient * speed * speed * obj.radius;
+    float ax = -(obj.vx / speed) * dragForce / obj.mass;
+    float ay = -(obj.vy / speed) * dragForce / obj.mass;
+    
+    obj.vx += ax * dt;
+    obj.vy += ay * dt;
+}
+
+static inline void frictionKickDrift(PhysicsObject& obj, float gravity, float subdt) {
+    constexpr float friction = 0.08f;
+    Real v = std::sqrt(obj.vx * obj.vx + obj.vy * obj.vy);
+    if (v > 1e-6f) {
+        Real drag = friction * subdt;
+        Real scale = std::max(Real(0), v - drag) / v;
+        obj.vx *= scale;
+        obj.vy *= scale;
+    }
+    obj.vy += gravity * subdt;
+    obj.x += obj.vx * subdt;
+    obj.y += obj.vy * subdt;
+}
+
+static inline void spinParticle(PhysicsObject& obj, float dt) {
+    if (std::abs(obj.spin) > 1e-6f) {
+        obj.spinAngle += obj.spin * dt;
+        while (obj.spinAngle >= 2 * M_PI) obj.spinAngle -= 2 * M_PI;
+        while (obj.spinAngle < 0) obj.spinAngle += 2 * M_PI;
+    }
+}
+
+static inline void clampToWalls(PhysicsObject& obj, float left, float right, float bottom, float top) {
+    constexpr float wallDamping = 0.2f;
+    if (obj.x - obj.radius < left) {
+        obj.x = left + obj.radius;
+        obj.vx = -obj.vx * wallDamping;
+    }
+    if (obj.x + obj.radius > right) {
+        obj.x = right - obj.radius;
+        obj.vx = -obj.vx * wallDamping;
+    }
+    if (obj.y - obj.radius < bottom) {
+        obj.y = bottom + obj.radius;
+        obj.vy = -obj.vy * wallDamping;
+    }
+    if (obj.y + obj.radius > top) {
+        obj.y = top - obj.radius;
+        obj.vy = -obj.vy * wallDamping;
+    }
 }
 
 void PhysicsWorld::applyAirDrag(float dt) {
     if (airDragCoefficient <= 0.0f) return;
     
     for (auto& obj : objects) {
-        if (obj.isStatic) continue;
-        
-        float speed = std::sqrt(obj.vx * obj.vx + obj.vy * obj.vy);
-        if (speed < 1e-6f) continue;
-        
-        float dragForce = airDragCoefficient * speed * speed * obj.radius;
-        float ax = -(obj.vx / speed) * dragForce / obj.mass;
-        float ay = -(obj.vy / speed) * dragForce / obj.mass;
-        
-        obj.vx += ax * dt;
-        obj.vy += ay * dt;
+        if (obj.isStatic || obj.sleeping) continue;
+        airDragParticle(obj, airDragCoefficient, dt);
     }
 }
 
@@ -143,12 +654,14 @@ void PhysicsWorld::applyTidalForces() {
             
             float dx = objects[j].x - obj.x;
             float dy = objects[j].y - obj.y;
-            float dist = std::sqrt(dx * dx + dy * dy);
+            // Fast: nearest by squared distance, one root for the winner
+            float dist = fastMath ? dx * dx + dy * dy : std::sqrt(dx * dx + dy * dy);
             if (dist < minDist) {
                 minDist = dist;
                 closestIdx = j;
             }
         }
+        if (fastMath && minDist < 1e10f) minDist = std::sqrt(minDist);
         
         if (minDist < 1e9f) {
             const auto& massive = objects[closestIdx];
@@ -156,14 +669,22 @@ void PhysicsWorld::applyTidalForces() {
             
             if (minDist < tidalR) {
                 if (obj.mass > 0.1f) {
+                    if (events.wants(EventType::TidalDisruption)) {
+                        emitEvent(EventType::TidalDisruption, i, &massive, closestIdx, obj.mass);
+                    }
                     createDebrisField(obj.x, obj.y, 8, 0.02f);
+                    // The debris may have reallocated objects; obj and massive are stale
+                    if (allowSleeping) wakeRegion(objects[i].x, objects[i].y, objects[i].radius);
                     objects.erase(objects.begin() + i);
+                    invalidateNeighbours();
                     --i;
+                    continue;
                 }
             }
             
             if (obj.tidallyLocked && obj.orbitTarget == (int)closestIdx) {
-                float angle = std::atan2(massive.y - obj.y, massive.x - obj.x);
+                float angle = fastMath ? fastAtan2(massive.y - obj.y, massive.x - obj.x)
+                                       : std::atan2(massive.y - obj.y, massive.x - obj.x);
                 obj.spinAngle = angle;
                 obj.spin = 0.0f;
             }
@@ -172,6 +693,7 @@ void PhysicsWorld::applyTidalForces() {
 }
 
 void PhysicsWorld::updateTemperatures(float dt) {
+    size_t emitterCount = 0;
     for (auto& obj : objects) {
         if (obj.temperature > 273.0f) {
             obj.temperature -= dt * 0.1f;
@@ -181,17 +703,31 @@ void PhysicsWorld::updateTemperatures(float dt) {
             obj.temperature = 2000.0f + obj.mass * 300.0f;
             obj.emitsLight = true;
         }
-        
-        for (const auto& other : objects) {
-            if (other.emitsLight && &other != &obj) {
-                float dx = other.x - obj.x;
-                float dy = other.y - obj.y;
-                float distSq = dx * dx + dy * dy;
-                float dist = std::sqrt(distSq);
-                if (dist < 0.5f) {
-                    float heating = other.luminosity / (distSq + 0.01f) * dt;
-                    obj.temperature += heating * 0.5f;
-                }
+        if (obj.emitsLight) ++emitterCount;
+    }
+    if (emitterCount == 0) return;
+    
+    // Radiation reaches 0.5 units, far past any contact skin, so heating
+    // walks the few emitters rather than neighbour lists or every pair
+    StepArena::Scope scratch(stepArena);
+    Span<uint32_t> emitters = stepArena.allocate<uint32_t>(emitterCount);
+    size_t n = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        if (objects[i].emitsLight) emitters[n++] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = 0; i < objects.size(); ++i) {
+        auto& obj = objects[i];
+        for (uint32_t e : emitters) {
+            if (e == i) continue;
+            const auto& other = objects[e];
+            float dx = other.x - obj.x;
+            float dy = other.y - obj.y;
+            float distSq = dx * dx + dy * dy;
+            // Fast: squared compare, which can differ right at the cutoff
+            bool inRange = fastMath ? distSq < 0.25f : std::sqrt(distSq) < 0.5f;
+            if (inRange) {
+                float heating = other.luminosity / (distSq + 0.01f) * dt;
+                obj.temperature += heating * 0.5f;
             }
         }
     }
@@ -200,11 +736,15 @@ void PhysicsWorld::updateTemperatures(float dt) {
 void PhysicsWorld::handleSupernova(size_t starIndex) {
     if (starIndex >= objects.size()) return;
     
-    auto& star = objects[starIndex];
-    if (star.type != ObjectType::Star) return;
+    if (objects[starIndex].type != ObjectType::Star) return;
     
-    float explosionEnergy = star.mass * 10.0f;
-    createDebrisField(star.x, star.y, 50, 0.15f);
+    float explosionEnergy = objects[starIndex].mass * 10.0f;
+    if (events.wants(EventType::Supernova)) {
+        emitEvent(EventType::Supernova, starIndex, nullptr, PhysicsEvent::none, explosionEnergy);
+    }
+    // Appending the debris may reallocate objects, so take the reference after
+    createDebrisField(objects[starIndex].x, objects[starIndex].y, 50, 0.15f);
+    auto& star = objects[starIndex];
     
     for (auto& obj : objects) {
         if (&obj == &star) continue;
@@ -213,6 +753,7 @@ void PhysicsWorld::handleSupernova(size_t starIndex) {
         float distSq = dx * dx + dy * dy;
         float dist = std::sqrt(distSq);
         if (dist < 0.8f) {
+            wakeBody(obj);
             float force = explosionEnergy / (distSq + 0.01f);
             float norm = dist + 1e-6f;
             obj.vx += (dx / norm) * force * 0.01f;
@@ -237,49 +778,60 @@ void PhysicsWorld::handleSupernova(size_t starIndex) {
 }
 
 void PhysicsWorld::createDebrisField(float x, float y, int count, float speed) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * M_PI);
-    std::uniform_real_distribution<float> speedDist(speed * 0.5f, speed * 1.5f);
+    Philox rng(seed);
+    uint64_t stream = randomStreams++;
     
-    for (int i = 0; i < count; ++i) {
-        float angle = angleDist(gen);
-        float s = speedDist(gen);
-        
-        Particle debris;
-        debris.x = x;
-        debris.y = y;
-        debris.vx = std::cos(angle) * s;
-        debris.vy = std::sin(angle) * s;
-        debris.radius = 0.008f;
-        debris.mass = 0.05f;
-        debris.type = ObjectType::Asteroid;
-        debris.color = {0.6f, 0.5f, 0.4f};
-        debris.spin = angleDist(gen) * 5.0f;
-        debris.lifetime = 30.0f;
-        
-        objects.push_back(debris);
-    }
+    // Built in place; debris starts stacked on the explosion point, so no
+    // overlap rejection
+    Span<Particle> debrisField = appendObjects(static_cast<size_t>(std::max(count, 0)));
+    pool().parallelFor(debrisField.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Philox::Block r = rng(stream, i);
+            float angle = Philox::uniform(r[0], 0.0f, 2.0f * M_PI);
+            float s = Philox::uniform(r[1], speed * 0.5f, speed * 1.5f);
+            
+            Particle& debris = debrisField[i];
+            debris.x = x;
+            debris.y = y;
+            debris.vx = std::cos(angle) * s;
+            debris.vy = std::sin(angle) * s;
+            debris.radius = 0.008f;
+            debris.mass = 0.05f;
+            debris.type = ObjectType::Asteroid;
+            debris.color = {0.6f, 0.5f, 0.4f};
+            debris.spin = Philox::uniform(r[2], 0.0f, 2.0f * M_PI) * 5.0f;
+            debris.lifetime = 30.0f;
+        }
+    }, 1024);
 }
 
 void PhysicsWorld::addForceField(const ForceField& field) {
     forceFields.push_back(field);
+    forceFieldsDirty = true;
 }
 
 void PhysicsWorld::removeForceField(size_t index) {
     if (index < forceFields.size()) {
         forceFields.erase(forceFields.begin() + index);
+        forceFieldsDirty = true;
     }
 }
 
 void PhysicsWorld::clearForceFields() {
     forceFields.clear();
+    forceFieldsDirty = true;
+}
+
+void PhysicsWorld::setForceFieldActive(size_t index, bool active) {
+    if (index < forceFields.size() && forceFields[index].active != active) {
+        forceFields[index].active = active;
+        forceFieldsDirty = true;
+    }
 }
 
 void PhysicsWorld::createGalaxy(float centerX, float centerY, int armCount, int starsPerArm) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> offsetDist(-0.05f, 0.05f);
+    Philox rng(seed);
+    uint64_t stream = randomStreams++;
     
     // Central black hole
     Particle bh;
@@ -292,21 +844,27 @@ void PhysicsWorld::createGalaxy(float centerX, float centerY, int armCount, int
     bh.isStatic = true;
     bh.color = {0.1f, 0.1f, 0.1f};
     bh.spin = 8.0f;
-    addObject(bh);
     
-    // Spiral arms
-    for (int arm = 0; arm < armCount; ++arm) {
-        float baseAngle = (2.0f * M_PI * arm) / armCount;
-        
-        for (int i = 0; i < starsPerArm; ++i) {
+    // Spiral arms; star k of the batch draws from counter k, so the fill can
+    // be split across threads
+    size_t arms = std::max(armCount, 0);
+    size_t perArm = std::max(starsPerArm, 0);
+    std::vector<Particle> galaxy(1 + arms * perArm);
+    galaxy[0] = bh;
+    pool().parallelFor(arms * perArm, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            size_t arm = k / perArm;
+            size_t i = k % perArm;
+            float baseAngle = (2.0f * M_PI * arm) / armCount;
             float t = float(i) / starsPerArm;
             float radius = 0.15f + t * 0.6f;
             float spiralAngle = baseAngle + t * 2.0f * M_PI;
             
-            float x = centerX + radius * std::cos(spiralAngle) + offsetDist(gen);
-            float y = centerY + radius * std::sin(spiralAngle) + offsetDist(gen);
+            Philox::Block r = rng(stream, k);
+            float x = centerX + radius * std::cos(spiralAngle) + Philox::uniform(r[0], -0.05f, 0.05f);
+            float y = centerY + radius * std::sin(spiralAngle) + Philox::uniform(r[1], -0.05f, 0.05f);
             
-            Particle star;
+            Particle& star = galaxy[1 + k];
             star.x = x;
             star.y = y;
             star.radius = 0.012f;
@@ -319,54 +877,64 @@ void PhysicsWorld::createGalaxy(float centerX, float centerY, int armCount, int
             star.spin = 1.0f;
             
             // Orbital velocity
-            float v = std::sqrt(G * bh.mass / std::max(radius, 0.1f)) * 0.8f;
+            float v = std::sqrt(static_cast<float>(G) * bh.mass / std::max(radius, 0.1f)) * 0.8f;
             star.vx = -v * std::sin(spiralAngle);
             star.vy = v * std::cos(spiralAngle);
-            
-            addObject(star);
         }
-    }
+    }, 1024);
+    addObjects(galaxy);
 }
 
 void PhysicsWorld::createAsteroidBelt(float centerX, float centerY, float innerR, float outerR, int count) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> radiusDist(innerR, outerR);
-    std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * M_PI);
+    Philox rng(seed);
+    uint64_t stream = randomStreams++;
     
-    for (int i = 0; i < count; ++i) {
-        float r = radiusDist(gen);
-        float angle = angleDist(gen);
-        
-        Particle ast;
-        ast.x = centerX + r * std::cos(angle);
-        ast.y = centerY + r * std::sin(angle);
-        ast.radius = 0.01f;
-        ast.mass = 0.1f;
-        ast.type = ObjectType::Asteroid;
-        ast.color = {0.6f, 0.5f, 0.4f};
-        ast.spin = angleDist(gen) * 3.0f;
-        
-        // Find central massive object for orbital velocity
-        float centralMass = 10.0f;
-        for (const auto& obj : objects) {
-            float dx = obj.x - centerX;
-            float dy = obj.y - centerY;
-            float dist = std::sqrt(dx * dx + dy * dy);
-            if (dist < 0.1f && obj.mass > centralMass) {
-                centralMass = obj.mass;
-            }
+    // Find central massive object for orbital velocity
+    float centralMass = 10.0f;
+    for (const auto& obj : objects) {
+        float dx = obj.x - centerX;
+        float dy = obj.y - centerY;
+        float dist = std::sqrt(dx * dx + dy * dy);
+        if (dist < 0.1f && obj.mass > centralMass) {
+            centralMass = obj.mass;
         }
-        
-        float v = std::sqrt(G * centralMass / std::max(r, 0.1f));
-        ast.vx = -v * std::sin(angle);
-        ast.vy = v * std::cos(angle);
-        
-        addObject(ast);
     }
+    
+    std::vector<Particle> belt(std::max(count, 0));
+    pool().parallelFor(belt.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Philox::Block u = rng(stream, i);
+            float r = Philox::uniform(u[0], innerR, outerR);
+            float angle = Philox::uniform(u[1], 0.0f, 2.0f * M_PI);
+            
+            Particle& ast = belt[i];
+            ast.x = centerX + r * std::cos(angle);
+            ast.y = centerY + r * std::sin(angle);
+            ast.radius = 0.01f;
+            ast.mass = 0.1f;
+            ast.type = ObjectType::Asteroid;
+            ast.color = {0.6f, 0.5f, 0.4f};
+            ast.spin = Philox::uniform(u[2], 0.0f, 2.0f * M_PI) * 3.0f;
+            
+            float v = std::sqrt(static_cast<float>(G) * centralMass / std::max(r, 0.1f));
+            ast.vx = -v * std::sin(angle);
+            ast.vy = v * std::cos(angle);
+        }
+    }, 1024);
+    addObjects(belt);
 }
 
-void PhysicsWorld::step(float dt) {
+template <class Features>
+void PhysicsWorld::stepImpl(float dt) {
+    stepArena.reset();
+    // Without the trails feature no object holds a ring, so any still live
+    // belong to removed bodies and the sync releases them
+    if (Features::trails || trails.liveCount() > 0) {
+        trails.sync(objects);
+    }
+    checkSleepEnvironment();
+    if (events.active()) events.prepare(pool());
+    
     // CCD: Check max movement
     float maxMove = 0.0f;
     for (const auto& obj : objects) {
@@ -374,11 +942,13 @@ void PhysicsWorld::step(float dt) {
         if (move > maxMove) maxMove = move;
     }
     int substeps = std::max(1, int(std::ceil(maxMove / 0.5f / dt)));
+    if (maxSubsteps > 0) substeps = std::min(substeps, maxSubsteps);
     float subdt = dt / substeps;
     
     for (int s = 0; s < substeps; ++s) {
-        // Black hole absorption
-        std::vector<size_t> toAbsorb;
+        // Black hole absorption: swallowed bodies are flagged, then removed in one pass
+        StepArena::Scope absorbScratch(stepArena);
+        Span<uint8_t> absorbed;
         for (size_t i = 0; i < objects.size(); ++i) {
             auto& obj = objects[i];
             if (obj.type == ObjectType::BlackHole) {
@@ -386,10 +956,13 @@ void PhysicsWorld::step(float dt) {
                     if (i == j) continue;
                     auto& other = objects[j];
                     if (other.type == ObjectType::BlackHole) continue;
-                    float dx = other.x - obj.x;
-                    float dy = other.y - obj.y;
-                    float distSq = dx * dx + dy * dy;
+                    Real dx = other.x - obj.x;
+                    Real dy = other.y - obj.y;
+                    Real distSq = dx * dx + dy * dy;
                     if (distSq < obj.eventHorizon * obj.eventHorizon) {
+                        if (events.wants(EventType::Absorption)) {
+                            emitEvent(EventType::Absorption, i, &other, j, other.mass);
+                        }
                         float totalMass = obj.mass + other.mass;
                         obj.color.r = (obj.color.r * obj.mass + other.color.r * other.mass) / totalMass;
                         obj.color.g = (obj.color.g * obj.mass + other.color.g * other.mass) / totalMass;
@@ -400,42 +973,56 @@ void PhysicsWorld::step(float dt) {
                         obj.y = (obj.y * obj.mass + other.y * other.mass) / totalMass;
                         obj.mass = totalMass;
                         obj.radius = std::sqrt(obj.radius * obj.radius + other.radius * other.radius);
-                        toAbsorb.push_back(j);
+                        if (allowSleeping) wakeRegion(other.x, other.y, other.radius);
+                        if (absorbed.empty()) absorbed = stepArena.allocate<uint8_t>(objects.size());
+                        absorbed[j] = 1;
                         stats.objectsAbsorbed++;
                     }
                 }
             }
         }
         
-        std::sort(toAbsorb.begin(), toAbsorb.end());
-        toAbsorb.erase(std::unique(toAbsorb.begin(), toAbsorb.end()), toAbsorb.end());
-        for (int k = static_cast<int>(toAbsorb.size()) - 1; k >= 0; --k) {
-            size_t idx = toAbsorb[k];
-            if (idx < objects.size()) objects.erase(objects.begin() + idx);
+        if (!absorbed.empty()) {
+            size_t kept = 0;
+            for (size_t i = 0; i < objects.size(); ++i) {
+                if (absorbed[i]) continue;
+                if (kept != i) objects[kept] = std::move(objects[i]);
+                ++kept;
+            }
+            objects.erase(objects.begin() + kept, objects.end());
+            invalidateNeighbours();
         }
         
         // Planet orbits
-        for (auto& obj : objects) {
-            if (obj.type == ObjectType::Planet && obj.orbitTarget >= 0 && obj.orbitTarget < (int)objects.size()) {
-                const auto& target = objects[obj.orbitTarget];
-                float angle = obj.orbitAngle;
-                float r = obj.orbitRadius;
-                obj.x = target.x + r * std::cos(angle);
-                obj.y = target.y + r * std::sin(angle);
-                float v = std::sqrt(0.5f * target.mass / std::max(r, 1e-4f));
-                obj.vx = -v * std::sin(angle) + target.vx;
-                obj.vy = v * std::cos(angle) + target.vy;
-                obj.orbitAngle += 0.01f;
+        if constexpr (Features::orbits) {
+            for (auto& obj : objects) {
+                if (obj.type == ObjectType::Planet && obj.orbitTarget >= 0 && obj.orbitTarget < (int)objects.size()) {
+                    const auto& target = objects[obj.orbitTarget];
+                    float angle = obj.orbitAngle;
+                    float r = obj.orbitRadius;
+                    obj.x = target.x + r * std::cos(angle);
+                    obj.y = target.y + r * std::sin(angle);
+                    float v = std::sqrt(0.5f * target.mass / std::max(r, 1e-4f));
+                    obj.vx = -v * std::sin(angle) + target.vx;
+                    obj.vy = v * std::cos(angle) + target.vy;
+                    obj.orbitAngle += 0.01f;
+                }
             }
         }
         
-        // Spin
-        for (auto& obj : objects) {
-            if (std::abs(obj.spin) > 1e-6f) {
-                obj.spinAngle += obj.spin * subdt;
-                while (obj.spinAngle >= 2 * M_PI) obj.spinAngle -= 2 * M_PI;
-                while (obj.spinAngle < 0) obj.spinAngle += 2 * M_PI;
+        auto removeObject = [&](size_t i) {
+            if (events.wants(EventType::Expiry)) {
+                emitEvent(EventType::Expiry, i, nullptr, PhysicsEvent::none, objects[i].age);
             }
+            // Whatever rested on the body falls again
+            if (allowSleeping) wakeRegion(objects[i].x, objects[i].y, objects[i].radius);
+            objects.erase(objects.begin() + i);
+            invalidateNeighbours();
+        };
+        
+        // Spin
+        for (size_t i = 0; i < objects.size(); ++i) {
+            spinParticle(objects[i], subdt);
         }
         
         // Age and lifetime
@@ -445,160 +1032,403 @@ void PhysicsWorld::step(float dt) {
                 if (objects[i].type == ObjectType::Star) {
                     handleSupernova(i);
                 } else {
-                    objects.erase(objects.begin() + i);
+                    removeObject(i);
                     --i;
                 }
             }
         }
         
+        // Sleepers are pulled too, so an approaching mass can wake them
         applyGravityForces();
-        applyForceFields();
-        applyAirDrag(subdt);
+        if (allowSleeping) checkSleeperPull();
+        if constexpr (Features::forceFields) {
+            applyForceFields();
+        }
         
-        constexpr float friction = 0.08f;
-        for (auto& obj : objects) {
-            if (!obj.isStatic) {
-                float v = std::sqrt(obj.vx * obj.vx + obj.vy * obj.vy);
-                if (v > 1e-6f) {
-                    float drag = friction * subdt;
-                    float scale = std::max(0.0f, v - drag) / v;
-                    obj.vx *= scale;
-                    obj.vy *= scale;
-                }
-                obj.vy += gravity * subdt;
-                obj.x += obj.vx * subdt;
-                obj.y += obj.vy * subdt;
-                
-                // Update trail
-                if (obj.trail && obj.type == ObjectType::Comet) {
-                    obj.trail->addPoint(obj.x, obj.y);
+        // Drag, friction, kick, drift and trail are per body, so one sweep does
+        // them all; walls wait for collisions, which need every position
+        for (size_t i = 0; i < objects.size(); ++i) {
+            auto& obj = objects[i];
+            if (obj.isStatic || obj.sleeping) continue;
+            if constexpr (Features::airDrag) {
+                airDragParticle(obj, airDragCoefficient, subdt);
+            }
+            frictionKickDrift(obj, gravity, subdt);
+            if constexpr (Features::trails) {
+                if (obj.trail >= 0) {
+                    trails.addPoint(obj.trail, obj.x, obj.y);
                 }
             }
         }
         
         handleCollisions();
-        handleWalls();
+        if (!openBoundary) handleWalls();
+        if (allowSleeping) updateSleep(subdt);
     }
     
     applyTidalForces();
     updateTemperatures(dt);
+    
+    if (autoRebase) {
+        const PhysicsObject* anchor = nullptr;
+        for (const auto& obj : objects) {
+            if (!obj.isStatic && (!anchor || obj.mass > anchor->mass)) anchor = &obj;
+        }
+        if (anchor && anchor->x * anchor->x + anchor->y * anchor->y > Real(rebaseDistance) * rebaseDistance) {
+            rebaseOrigin(originX + anchor->x, originY + anchor->y);
+        }
+    }
+    
+    if (events.active()) events.drain();
+    // After the drain, so the step's events carry the indices they were emitted with
+    if (reorderObjects && reorderInterval > 0 && (stepCount + 1) % reorderInterval == 0
+        && localityDisorder() > reorderThreshold) {
+        reorderForLocality();
+    }
+
+    ++stepCount;
+    ++revision;
+    if (hashEveryStep || logStateHash) {
+        lastStateHash = stateHash();
+        if (logStateHash) {
+            printf("[step %llu] state %016llx\n", static_cast<unsigned long long>(stepCount),
+                   static_cast<unsigned long long>(lastStateHash));
+        }
+    }
+    history.record(*this);
 }
 
-void PhysicsWorld::applyGravityForces() {
-    for (size_t i = 0; i < objects.size(); ++i) {
-        for (size_t j = 0; j < objects.size(); ++j) {
-            if (i == j) continue;
+// Runtime dispatch onto the stepImpl instantiation whose feature set matches
+// the world; a disabled feature costs neither a pass nor a branch.
+template <size_t... Masks>
+std::array<PhysicsWorld::StepFn, sizeof...(Masks)> PhysicsWorld::makeStepTable(std::index_sequence<Masks...>) {
+    return {{&PhysicsWorld::stepImpl<StepFeatures<static_cast<unsigned>(Masks)>>...}};
+}
+
+unsigned PhysicsWorld::activeStepFeatures() const {
+    unsigned mask = 0;
+    if (airDragCoefficient > 0.0f) mask |= StepAirDrag;
+    for (const auto& field : forceFields) {
+        if (field.active) {
+            mask |= StepForceFields;
+            break;
+        }
+    }
+    for (const auto& obj : objects) {
+        if (obj.trailLength > 0 || obj.trail >= 0) mask |= StepTrails;
+        if (obj.type == ObjectType::Planet && obj.orbitTarget >= 0) mask |= StepOrbits;
+    }
+    return mask;
+}
+
+void PhysicsWorld::step(float dt) {
+    static const auto table = makeStepTable(std::make_index_sequence<StepFeatureCount>{});
+    (this->*table[activeStepFeatures()])(dt);
+}
+
+template <class Policy, bool Fast>
+void PhysicsWorld::applyPairwiseGravity() {
+    using P = typename Policy::Position;
+    using A = typename Policy::Accum;
+    const A g = static_cast<A>(G);
+    // Row i only writes body i and sums j in index order, so rows can run on
+    // any thread and still give the same bits
+    pool().parallelFor(objects.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
             PhysicsObject& a = objects[i];
-            PhysicsObject& b = objects[j];
-            if (a.isStatic || b.isStatic) continue;
-            float dx = b.x - a.x;
-            float dy = b.y - a.y;
-            float distSq = dx * dx + dy * dy;
-            if (distSq < 1e-8f) continue;
-            float dist = std::sqrt(distSq) + 1e-6f;
-            float F = G * a.mass * b.mass / distSq;
-            float ax = F * dx / (dist * a.mass);
-            float ay = F * dy / (dist * a.mass);
-            a.vx += ax * 0.001f;
-            a.vy += ay * 0.001f;
+            if (a.isStatic) continue;
+            A sumX = 0, sumY = 0;
+            for (size_t j = 0; j < objects.size(); ++j) {
+                if (i == j) continue;
+                const PhysicsObject& b = objects[j];
+                if (b.isStatic) continue;
+                // Offsets in the position type, everything after in the accumulator type
+                A dx = static_cast<A>(static_cast<P>(b.x) - static_cast<P>(a.x));
+                A dy = static_cast<A>(static_cast<P>(b.y) - static_cast<P>(a.y));
+                A distSq = dx * dx + dy * dy;
+                if (distSq < A(1e-8)) continue;
+                if constexpr (Fast) {
+                    // m_b d / |d|^3 summed per row, one root and one divide a
+                    // pair, without the 1e-6 offset of the form below
+                    A inv = A(1) / std::sqrt(distSq);
+                    A k = b.mass * inv * inv * inv;
+                    sumX += k * dx;
+                    sumY += k * dy;
+                    continue;
+                }
+                A dist = std::sqrt(distSq) + A(1e-6);
+                A F = g * a.mass * b.mass / distSq;
+                A ax = F * dx / (dist * a.mass);
+                A ay = F * dy / (dist * a.mass);
+                a.vx += ax * A(0.001);
+                a.vy += ay * A(0.001);
+            }
+            if constexpr (Fast) {
+                a.vx += g * sumX * A(0.001);
+                a.vy += g * sumY * A(0.001);
+            }
         }
+    }, 64);
+}
+
+void PhysicsWorld::applyGravityForces() {
+    if (gravityTheta > 0.0f) {
+        // Static bodies neither pull nor get pulled, as in the pairwise loop
+        gravityTree.build(objects, false);
+        const Accum g = static_cast<Accum>(G);
+        pool().parallelFor(objects.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                PhysicsObject& a = objects[i];
+                if (a.isStatic) continue;
+                Accum gx, gy;
+                gravityTree.field(a.x, a.y, gravityTheta, 0.0f, gx, gy, static_cast<int>(i));
+                a.vx += g * gx * Accum(0.001);
+                a.vy += g * gy * Accum(0.001);
+            }
+        }, 256);
+    } else if (singlePrecisionForces) {
+        if (fastMath) {
+            applyPairwiseGravity<PrecisionPolicy<Real, float>, true>();
+        } else {
+            applyPairwiseGravity<PrecisionPolicy<Real, float>, false>();
+        }
+    } else if (fastMath) {
+        applyPairwiseGravity<Precision, true>();
+    } else {
+        applyPairwiseGravity<Precision, false>();
     }
+    applyFarField();
+}
+
+void PhysicsWorld::applyFarField() {
+    if (farField.empty()) return;
+    const Accum g = static_cast<Accum>(G);
+    pool().parallelFor(objects.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            PhysicsObject& a = objects[i];
+            if (a.isStatic) continue;
+            Accum ax = 0, ay = 0;
+            for (const auto& src : farField) {
+                // r points from the source to the body
+                Accum rx = static_cast<Accum>(a.x - src.x);
+                Accum ry = static_cast<Accum>(a.y - src.y);
+                Accum r2 = rx * rx + ry * ry;
+                if (r2 < Accum(1e-8)) continue;
+                Accum inv2 = Accum(1) / r2;
+                Accum inv3 = inv2 / std::sqrt(r2);
+                // Monopole -M r / r^3, quadrupole (Q r) / r^5 - 5/2 (r.Q.r) r / r^7
+                Accum qrx = src.qxx * rx + src.qxy * ry;
+                Accum qry = src.qxy * rx + src.qyy * ry;
+                Accum rqr = rx * qrx + ry * qry;
+                Accum inv5 = inv3 * inv2;
+                Accum k = -src.mass * inv3 - Accum(2.5) * rqr * inv5 * inv2;
+                ax += k * rx + qrx * inv5;
+                ay += k * ry + qry * inv5;
+            }
+            a.vx += g * ax * Accum(0.001);
+            a.vy += g * ay * Accum(0.001);
+        }
+    }, 64);
+}
+
+void PhysicsWorld::emitEvent(EventType type, size_t a, const PhysicsObject* other, size_t b, float value) {
+    const PhysicsObject& body = objects[a];
+    PhysicsEvent e;
+    e.type = type;
+    e.step = stepCount;
+    e.a = static_cast<uint32_t>(a);
+    e.b = static_cast<uint32_t>(b);
+    e.typeA = body.type;
+    e.typeB = other ? other->type : ObjectType::Normal;
+    e.massA = body.mass;
+    e.massB = other ? other->mass : 0.0f;
+    e.x = static_cast<float>(body.x);
+    e.y = static_cast<float>(body.y);
+    e.value = value;
+    events.emit(e);
 }
 
 void PhysicsWorld::handleWalls() {
-    constexpr float wallDamping = 0.2f;
     for (auto& obj : objects) {
-        if (obj.isStatic) continue;
-        if (obj.x - obj.radius < left) {
-            obj.x = left + obj.radius;
-            obj.vx = -obj.vx * wallDamping;
+        if (obj.isStatic || obj.sleeping) continue;
+        clampToWalls(obj, left, right, bottom, top);
+    }
+}
+
+void PhysicsWorld::resolveCollision(size_t i, size_t j) {
+    const float percent = 0.2f;
+    const float slop = 1e-4f;
+    PhysicsObject& a = objects[i];
+    PhysicsObject& b = objects[j];
+    // A sleeping body holds still like a static one until something wakes it
+    bool fixedA = a.isStatic || a.sleeping;
+    bool fixedB = b.isStatic || b.sleeping;
+    if (fixedA && fixedB) return;
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float distSq = dx * dx + dy * dy;
+    float minDist = a.radius + b.radius;
+    if (distSq < minDist * minDist) {
+        if (a.sleeping || b.sleeping) {
+            // A moving body wakes what it hits; a still one settles against it
+            const PhysicsObject& mover = a.sleeping ? b : a;
+            if (mover.vx * mover.vx + mover.vy * mover.vy > sleepSpeed * sleepSpeed) {
+                wakeObject(a.sleeping ? i : j);
+                fixedA = a.isStatic;
+                fixedB = b.isStatic;
+            }
+        }
+        if (trackSleepContacts) {
+            if (!a.isStatic && !b.isStatic) {
+                sleepContacts.push_back(static_cast<uint32_t>(i));
+                sleepContacts.push_back(static_cast<uint32_t>(j));
+            }
+            if (fixedA) sleepSupported[j] = 1;
+            if (fixedB) sleepSupported[i] = 1;
         }
-        if (obj.x + obj.radius > right) {
-            obj.x = right - obj.radius;
-            obj.vx = -obj.vx * wallDamping;
+        stats.totalCollisions++;
+        float dist, nx, ny;
+        if (fastMath) {
+            // Offset keeps coincident centres at a zero normal, as below
+            float inv = 1.0f / std::sqrt(distSq + 1e-16f);
+            dist = distSq * inv;
+            nx = dx * inv;
+            ny = dy * inv;
+        } else {
+            dist = std::sqrt(distSq) + 1e-8f;
+            nx = dx / dist;
+            ny = dy / dist;
         }
-        if (obj.y - obj.radius < bottom) {
-            obj.y = bottom + obj.radius;
-            obj.vy = -obj.vy * wallDamping;
+        float ma = fixedA ? 1e10f : a.mass;
+        float mb = fixedB ? 1e10f : b.mass;
+        float penetration = minDist - dist;
+        float correction = std::max(penetration - slop, 0.0f) / (ma + mb) * percent;
+        if (!fixedA && !fixedB) {
+            a.x -= nx * correction * (mb / (ma + mb));
+            a.y -= ny * correction * (mb / (ma + mb));
+            b.x += nx * correction * (ma / (ma + mb));
+            b.y += ny * correction * (ma / (ma + mb));
+        } else if (!fixedA) {
+            a.x -= nx * correction;
+            a.y -= ny * correction;
+        } else if (!fixedB) {
+            b.x += nx * correction;
+            b.y += ny * correction;
         }
-        if (obj.y + obj.radius > top) {
-            obj.y = top - obj.radius;
-            obj.vy = -obj.vy * wallDamping;
+        float vax = a.vx, vay = a.vy;
+        float vbx = b.vx, vby = b.vy;
+        float van = vax * nx + vay * ny;
+        float vbn = vbx * nx + vby * ny;
+        float relVel = van - vbn;
+        if (relVel < 0.0f) return;
+        float impulse = -(1.0f + restitution) * relVel / (1.0f / ma + 1.0f / mb);
+        if (events.wants(EventType::Collision)) emitEvent(EventType::Collision, i, &b, j, -impulse);
+        float impA = impulse / ma;
+        float impB = impulse / mb;
+        if (!fixedA) {
+            a.vx += impA * nx;
+            a.vy += impA * ny;
+        }
+        if (!fixedB) {
+            b.vx -= impB * nx;
+            b.vy -= impB * ny;
         }
     }
 }
 
-void PhysicsWorld::handleCollisions() {
-    updateSpatialGrid();
-    const float restitution = 0.95f;
+void PhysicsWorld::resolveGhostCollisions() {
+    // Same response as resolveCollision, but only this world's body moves;
+    // the ghost's owner applies the other half from its side
     const float percent = 0.2f;
     const float slop = 1e-4f;
-    
-    std::vector<std::pair<size_t, size_t>> checkedPairs;
-    
+    float maxGhostRadius = 0.0f;
+    for (const auto& ghost : ghosts) maxGhostRadius = std::max(maxGhostRadius, ghost.radius);
+    ghostGrid.build(ghosts, std::max(2.0f * maxGhostRadius, 1e-4f));
+    for (size_t i = 0; i < objects.size(); ++i) {
+        PhysicsObject& a = objects[i];
+        if (a.isStatic) continue;
+        float reach = a.radius + maxGhostRadius;
+        ghostGrid.forEachInRect(a.x - reach, a.y - reach, a.x + reach, a.y + reach, [&](size_t j) {
+            const PhysicsObject& b = ghosts[j];
+            float dx = b.x - a.x;
+            float dy = b.y - a.y;
+            float distSq = dx * dx + dy * dy;
+            float minDist = a.radius + b.radius;
+            if (distSq >= minDist * minDist) return;
+            if (a.sleeping) {
+                if (b.vx * b.vx + b.vy * b.vy <= sleepSpeed * sleepSpeed) return;
+                wakeObject(i);
+            }
+            stats.totalCollisions++;
+            float dist, nx, ny;
+            if (fastMath) {
+                float inv = 1.0f / std::sqrt(distSq + 1e-16f);
+                dist = distSq * inv;
+                nx = dx * inv;
+                ny = dy * inv;
+            } else {
+                dist = std::sqrt(distSq) + 1e-8f;
+                nx = dx / dist;
+                ny = dy / dist;
+            }
+            float ma = a.mass;
+            float mb = b.isStatic ? 1e10f : b.mass;
+            float correction = std::max(minDist - dist - slop, 0.0f) / (ma + mb) * percent;
+            a.x -= nx * correction * (b.isStatic ? 1.0f : mb / (ma + mb));
+            a.y -= ny * correction * (b.isStatic ? 1.0f : mb / (ma + mb));
+            float relVel = (a.vx * nx + a.vy * ny) - (b.vx * nx + b.vy * ny);
+            if (relVel < 0.0f) return;
+            float impulse = -(1.0f + restitution) * relVel / (1.0f / ma + 1.0f / mb);
+            if (events.wants(EventType::Collision)) {
+                emitEvent(EventType::Collision, i, &b, PhysicsEvent::none, -impulse);
+            }
+            a.vx += impulse / ma * nx;
+            a.vy += impulse / ma * ny;
+        });
+    }
+}
+
+template <class Fn>
+void PhysicsWorld::forEachCandidatePair(Fn fn) const {
+    // Every pair is visited exactly once: within a cell, then against the
+    // four forward neighbours (right, and the three cells above)
+    static const int forward[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    if (openBoundary) {
+        const uint32_t npos = SpatialHashGrid::npos;
+        for (const auto& cell : hashGrid.cells()) {
+            for (uint32_t i = cell.head; i != npos; i = hashGrid.next(i)) {
+                for (uint32_t j = hashGrid.next(i); j != npos; j = hashGrid.next(j)) {
+                    fn(std::min(i, j), std::max(i, j));
+                }
+            }
+            for (const auto& d : forward) {
+                uint32_t other = hashGrid.find(cell.cx + d[0], cell.cy + d[1]);
+                if (other == npos) continue;
+                for (uint32_t i = cell.head; i != npos; i = hashGrid.next(i)) {
+                    for (uint32_t j = other; j != npos; j = hashGrid.next(j)) {
+                        fn(std::min(i, j), std::max(i, j));
+                    }
+                }
+            }
+        }
+        return;
+    }
     for (int row = 0; row < gridRows; ++row) {
         for (int col = 0; col < gridCols; ++col) {
-            for (int di = -1; di <= 1; ++di) {
-                for (int dj = -1; dj <= 1; ++dj) {
-                    int nrow = row + di;
-                    int ncol = col + dj;
-                    if (nrow < 0 || nrow >= gridRows || ncol < 0 || ncol >= gridCols) continue;
-                    const auto& cellA = gridCells[row][col];
-                    const auto& cellB = gridCells[nrow][ncol];
-                    for (size_t idxA = 0; idxA < cellA.size(); ++idxA) {
-                        for (size_t idxB = 0; idxB < cellB.size(); ++idxB) {
-                            size_t i = cellA[idxA];
-                            size_t j = cellB[idxB];
-                            if (i >= j) continue;
-                            if (std::find(checkedPairs.begin(), checkedPairs.end(), std::make_pair(i, j)) != checkedPairs.end()) continue;
-                            checkedPairs.push_back({i, j});
-                            PhysicsObject& a = objects[i];
-                            PhysicsObject& b = objects[j];
-                            if (a.isStatic && b.isStatic) continue;
-                            float dx = b.x - a.x;
-                            float dy = b.y - a.y;
-                            float distSq = dx * dx + dy * dy;
-                            float minDist = a.radius + b.radius;
-                            if (distSq < minDist * minDist) {
-                                stats.totalCollisions++;
-                                float dist = std::sqrt(distSq) + 1e-8f;
-                                float nx = dx / dist;
-                                float ny = dy / dist;
-                                float ma = a.isStatic ? 1e10f : a.mass;
-                                float mb = b.isStatic ? 1e10f : b.mass;
-                                float penetration = minDist - dist;
-                                float correction = std::max(penetration - slop, 0.0f) / (ma + mb) * percent;
-                                if (!a.isStatic && !b.isStatic) {
-                                    a.x -= nx * correction * (mb / (ma + mb));
-                                    a.y -= ny * correction * (mb / (ma + mb));
-                                    b.x += nx * correction * (ma / (ma + mb));
-                                    b.y += ny * correction * (ma / (ma + mb));
-                                } else if (!a.isStatic) {
-                                    a.x -= nx * correction;
-                                    a.y -= ny * correction;
-                                } else if (!b.isStatic) {
-                                    b.x += nx * correction;
-                                    b.y += ny * correction;
-                                }
-                                float vax = a.vx, vay = a.vy;
-                                float vbx = b.vx, vby = b.vy;
-                                float van = vax * nx + vay * ny;
-                                float vbn = vbx * nx + vby * ny;
-                                float relVel = van - vbn;
-                                if (relVel < 0.0f) continue;
-                                float impulse = -(1.0f + restitution) * relVel / (1.0f / ma + 1.0f / mb);
-                                float impA = impulse / ma;
-                                float impB = impulse / mb;
-                                if (!a.isStatic) {
-                                    a.vx += impA * nx;
-                                    a.vy += impA * ny;
-                                }
-                                if (!b.isStatic) {
-                                    b.vx -= impB * nx;
-                                    b.vy -= impB * ny;
-                                }
-                            }
-                        }
+            Span<const size_t> cellA = gridCell(row, col);
+            for (size_t a = 0; a < cellA.size(); ++a) {
+                for (size_t b = a + 1; b < cellA.size(); ++b) {
+                    fn(std::min(cellA[a], cellA[b]), std::max(cellA[a], cellA[b]));
+                }
+            }
+            for (const auto& d : forward) {
+                int ncol = col + d[0];
+                int nrow = row + d[1];
+                if (nrow < 0 || nrow >= gridRows || ncol < 0 || ncol >= gridCols) continue;
+                Span<const size_t> cellB = gridCell(nrow, ncol);
+                for (size_t i : cellA) {
+                    for (size_t j : cellB) {
+                        fn(std::min(i, j), std::max(i, j));
                     }
                 }
             }
@@ -606,16 +1436,509 @@ void PhysicsWorld::handleCollisions() {
     }
 }
 
+bool PhysicsWorld::neighboursStale() const {
+    if (!neighboursValid || neighboursOpen != openBoundary || neighboursSkinSetting != neighbourSkin
+        || neighbourX.size() != objects.size()) {
+        return true;
+    }
+    // Two bodies that each moved under half the skin cannot have closed it
+    const float half = 0.5f * neighboursSkin;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const auto& obj = objects[i];
+        float dx = static_cast<float>(obj.x - neighbourX[i]);
+        float dy = static_cast<float>(obj.y - neighbourY[i]);
+        float reach = half - std::max(obj.radius - neighbourRadius[i], 0.0f);
+        // Negated so a non-finite position counts as moved
+        if (!(dx * dx + dy * dy <= reach * reach) || reach < 0.0f) return true;
+    }
+    return false;
+}
+
+void PhysicsWorld::updateNeighbourLists() {
+    if (!neighboursStale()) return;
+    updateSpatialGrid();
+    // Pairs further apart than a cell are not enumerated, so they must not be
+    // able to close to contact before the next rebuild
+    float maxRadius = 0.0f;
+    for (const auto& obj : objects) maxRadius = std::max(maxRadius, obj.radius);
+    float cell = openBoundary ? hashGrid.cellSize() : std::min(cellWidth, cellHeight);
+    float skin = std::max(0.0f, std::min(neighbourSkin, cell - 2.0f * maxRadius));
+    neighbours.clear();
+    forEachCandidatePair([&](size_t i, size_t j) {
+        const auto& a = objects[i];
+        const auto& b = objects[j];
+        Real dx = b.x - a.x;
+        Real dy = b.y - a.y;
+        Real reach = a.radius + b.radius + skin;
+        if (dx * dx + dy * dy < reach * reach) {
+            neighbours.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(j)});
+        }
+    });
+    // Index order, not grid order: contacts then resolve in the same order
+    // whichever step the list was built at, so a replay from history matches.
+    // Counting sort on i; each body's few partners are then sorted by j.
+    {
+        StepArena::Scope scratch(stepArena);
+        Span<uint32_t> first = stepArena.allocate<uint32_t>(objects.size() + 1);
+        Span<NeighbourPair> sorted = stepArena.allocate<NeighbourPair>(neighbours.size());
+        for (const auto& pair : neighbours) ++first[pair.i + 1];
+        for (size_t i = 0; i < objects.size(); ++i) first[i + 1] += first[i];
+        for (const auto& pair : neighbours) sorted[first[pair.i]++] = pair;
+        uint32_t begin = 0;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            uint32_t end = first[i];
+            std::sort(sorted.data() + begin, sorted.data() + end,
+                      [](const NeighbourPair& a, const NeighbourPair& b) { return a.j < b.j; });
+            begin = end;
+        }
+        std::copy(sorted.begin(), sorted.end(), neighbours.begin());
+    }
+    neighbourX.resize(objects.size());
+    neighbourY.resize(objects.size());
+    neighbourRadius.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        neighbourX[i] = objects[i].x;
+        neighbourY[i] = objects[i].y;
+        neighbourRadius[i] = objects[i].radius;
+    }
+    neighboursValid = true;
+    neighboursOpen = openBoundary;
+    neighboursSkinSetting = neighbourSkin;
+    neighboursSkin = skin;
+    ++neighbourRebuilds;
+}
+
+void PhysicsWorld::handleCollisions() {
+    trackSleepContacts = allowSleeping;
+    if (trackSleepContacts) {
+        sleepContacts.clear();
+        sleepSupported.assign(objects.size(), 0);
+    }
+    if (!ghosts.empty()) resolveGhostCollisions();
+    if (useNeighbourLists) {
+        updateNeighbourLists();
+        for (const auto& pair : neighbours) resolveCollision(pair.i, pair.j);
+        return;
+    }
+    updateSpatialGrid();
+    forEachCandidatePair([&](size_t i, size_t j) { resolveCollision(i, j); });
+}
+
+void PhysicsWorld::wakeBody(PhysicsObject& obj) {
+    if (obj.sleeping && obj.sleepIsland != 0) wokenIslands.push_back(obj.sleepIsland);
+    obj.sleeping = false;
+    obj.sleepTime = 0.0f;
+    obj.sleepIsland = 0;
+}
+
+void PhysicsWorld::wakeObject(size_t index) {
+    if (index >= objects.size()) return;
+    wakeBody(objects[index]);
+}
+
+void PhysicsWorld::wakeAll() {
+    for (auto& obj : objects) {
+        obj.sleeping = false;
+        obj.sleepTime = 0.0f;
+        obj.sleepIsland = 0;
+    }
+    wokenIslands.clear();
+}
+
+void PhysicsWorld::wakeIslands() {
+    if (wokenIslands.empty()) return;
+    // Whatever rested on a woken body must not hang in the air after it moves
+    std::sort(wokenIslands.begin(), wokenIslands.end());
+    wokenIslands.erase(std::unique(wokenIslands.begin(), wokenIslands.end()), wokenIslands.end());
+    for (auto& obj : objects) {
+        if (!obj.sleeping || !std::binary_search(wokenIslands.begin(), wokenIslands.end(), obj.sleepIsland)) continue;
+        obj.sleeping = false;
+        obj.sleepTime = 0.0f;
+        obj.sleepIsland = 0;
+    }
+    wokenIslands.clear();
+}
+
+void PhysicsWorld::checkSleeperPull() {
+    const float limitSq = wakePull * wakePull;
+    for (auto& obj : objects) {
+        if (!obj.sleeping) continue;
+        // Sleepers start the pass at rest, so their velocity is the pull
+        float px = obj.vx, py = obj.vy;
+        obj.vx = 0;
+        obj.vy = 0;
+        if (std::isnan(obj.sleepPullX)) {
+            obj.sleepPullX = px;
+            obj.sleepPullY = py;
+            continue;
+        }
+        float dx = px - obj.sleepPullX;
+        float dy = py - obj.sleepPullY;
+        if (dx * dx + dy * dy > limitSq) {
+            wakeBody(obj);
+            obj.vx = px;
+            obj.vy = py;
+        }
+    }
+}
+
+void PhysicsWorld::wakeRegion(Real x, Real y, float radius) {
+    for (auto& obj : objects) {
+        if (!obj.sleeping) continue;
+        Real dx = obj.x - x;
+        Real dy = obj.y - y;
+        // A little past touching, so bodies resting with a gap of slop wake too
+        Real reach = radius + obj.radius + 1e-3f;
+        if (dx * dx + dy * dy < reach * reach) wakeBody(obj);
+    }
+}
+
+size_t PhysicsWorld::sleepingCount() const {
+    size_t count = 0;
+    for (const auto& obj : objects) count += obj.sleeping ? 1 : 0;
+    return count;
+}
+
+void PhysicsWorld::checkSleepEnvironment() {
+    if (!allowSleeping) {
+        for (auto& obj : objects) obj.sleeping = false;
+        wokenIslands.clear();
+        return;
+    }
+    wakeIslands();
+    // Sleepers rest against the walls under the gravity they fell asleep in
+    std::array<float, 4> walls = {{left, right, bottom, top}};
+    if (gravity != sleepGravity || walls != sleepWalls || openBoundary != sleepOpen) {
+        wakeAll();
+        sleepGravity = gravity;
+        sleepWalls = walls;
+        sleepOpen = openBoundary;
+    }
+}
+
+void PhysicsWorld::updateSleep(float dt) {
+    wakeIslands();
+    size_t n = objects.size();
+    // Islands are the connected sets of this substep's contacts
+    islandParent.resize(n);
+    for (size_t i = 0; i < n; ++i) islandParent[i] = static_cast<uint32_t>(i);
+    auto find = [&](uint32_t i) {
+        while (islandParent[i] != i) {
+            islandParent[i] = islandParent[islandParent[i]];
+            i = islandParent[i];
+        }
+        return i;
+    };
+    for (size_t k = 0; k + 1 < sleepContacts.size(); k += 2) {
+        uint32_t a = find(sleepContacts[k]);
+        uint32_t b = find(sleepContacts[k + 1]);
+        if (a != b) islandParent[std::max(a, b)] = std::min(a, b);
+    }
+    
+    // Per island: how long its least still body has been still, and whether
+    // it rests on anything
+    const float speedSq = sleepSpeed * sleepSpeed;
+    const float margin = 1e-3f;
+    const bool walls = !openBoundary;
+    const bool tracked = sleepSupported.size() == n;
+    islandTime.assign(n, timeToSleep);
+    islandSupported.assign(n, 0);
+    islandLabel.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        auto& obj = objects[i];
+        if (obj.isStatic) continue;
+        uint32_t root = find(static_cast<uint32_t>(i));
+        if (obj.sleeping) {
+            islandSupported[root] = 1;
+            if (islandLabel[root] == 0) islandLabel[root] = obj.sleepIsland;
+            continue;
+        }
+        float speedSqI = obj.vx * obj.vx + obj.vy * obj.vy;
+        // Bodies driven along an orbit are moved by position, never rest
+        bool orbiting = obj.type == ObjectType::Planet && obj.orbitTarget >= 0;
+        bool still = !orbiting && speedSqI <= speedSq && 0.5f * obj.mass * speedSqI <= sleepEnergy;
+        obj.sleepTime = still ? obj.sleepTime + dt : 0.0f;
+        islandTime[root] = std::min(islandTime[root], obj.sleepTime);
+        bool onWall = walls && (obj.x - obj.radius <= left + margin || obj.x + obj.radius >= right - margin ||
+                                obj.y - obj.radius <= bottom + margin || obj.y + obj.radius >= top - margin);
+        if (onWall || (tracked && sleepSupported[i])) islandSupported[root] = 1;
+    }
+    // A falling-asleep island joins the island of the sleepers it rests on,
+    // so waking any of them later wakes it too
+    bool anyFell = false;
+    for (size_t i = 0; i < n; ++i) {
+        auto& obj = objects[i];
+        if (obj.isStatic || obj.sleeping) continue;
+        uint32_t root = find(static_cast<uint32_t>(i));
+        if (islandSupported[root] && islandTime[root] >= timeToSleep) {
+            if (islandLabel[root] == 0) islandLabel[root] = ++sleepIslandCount;
+            obj.sleeping = true;
+            obj.sleepIsland = islandLabel[root];
+            obj.sleepPullX = obj.sleepPullY = std::numeric_limits<float>::quiet_NaN();
+            obj.vx = 0;
+            obj.vy = 0;
+            islandSupported[root] = 2;
+            anyFell = true;
+        }
+    }
+    if (!anyFell) return;
+    
+    // Sleepers of other islands touching one that fell asleep are merged
+    // into its label: union-find over the labels, each set named by its least
+    StepArena::Scope scratch(stepArena);
+    Span<uint32_t> merges = stepArena.allocate<uint32_t>(2 * n);
+    size_t mergeCount = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const auto& obj = objects[i];
+        if (!obj.sleeping || obj.sleepIsland == 0) continue;
+        uint32_t root = find(static_cast<uint32_t>(i));
+        if (islandSupported[root] == 2 && obj.sleepIsland != islandLabel[root]) {
+            merges[2 * mergeCount] = obj.sleepIsland;
+            merges[2 * mergeCount + 1] = islandLabel[root];
+            ++mergeCount;
+        }
+    }
+    if (mergeCount == 0) return;
+    Span<uint32_t> sorted = stepArena.allocate<uint32_t>(2 * mergeCount);
+    std::copy(merges.begin(), merges.begin() + 2 * mergeCount, sorted.begin());
+    std::sort(sorted.begin(), sorted.end());
+    uint32_t* last = std::unique(sorted.begin(), sorted.end());
+    Span<const uint32_t> ids(sorted.data(), static_cast<size_t>(last - sorted.begin()));
+    auto slot = [&](uint32_t label) {
+        return static_cast<uint32_t>(std::lower_bound(ids.begin(), ids.end(), label) - ids.begin());
+    };
+    Span<uint32_t> parent = stepArena.allocate<uint32_t>(ids.size());
+    for (uint32_t k = 0; k < parent.size(); ++k) parent[k] = k;
+    auto findLabel = [&](uint32_t k) {
+        while (parent[k] != k) k = parent[k] = parent[parent[k]];
+        return k;
+    };
+    for (size_t m = 0; m < mergeCount; ++m) {
+        uint32_t a = findLabel(slot(merges[2 * m]));
+        uint32_t b = findLabel(slot(merges[2 * m + 1]));
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    }
+    for (auto& obj : objects) {
+        if (!obj.sleeping || !std::binary_search(ids.begin(), ids.end(), obj.sleepIsland)) continue;
+        obj.sleepIsland = ids[findLabel(slot(obj.sleepIsland))];
+    }
+}
+
+// Spaces the low 16 bits of v out to the even bits
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0xFFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+void PhysicsWorld::mortonKeys(Span<uint32_t> keys, int bits) const {
+    // Square box around every finite position, split into 2^bits cells a side
+    Real minX = 0, minY = 0, maxX = 0, maxY = 0;
+    bool any = false;
+    for (const auto& obj : objects) {
+        if (!std::isfinite(static_cast<double>(obj.x)) || !std::isfinite(static_cast<double>(obj.y))) continue;
+        if (!any) {
+            minX = maxX = obj.x;
+            minY = maxY = obj.y;
+            any = true;
+        }
+        minX = std::min(minX, obj.x);
+        maxX = std::max(maxX, obj.x);
+        minY = std::min(minY, obj.y);
+        maxY = std::max(maxY, obj.y);
+    }
+    double extent = std::max(static_cast<double>(maxX - minX), static_cast<double>(maxY - minY));
+    const double cells = static_cast<double>(1u << bits);
+    const double scale = extent > 0.0 ? cells / extent : 0.0;
+    const int shift = 16 - bits;
+    pool().parallelFor(objects.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double qx = (static_cast<double>(objects[i].x) - static_cast<double>(minX)) * scale;
+            double qy = (static_cast<double>(objects[i].y) - static_cast<double>(minY)) * scale;
+            // Negated so NaN lands in the first cell
+            uint32_t cx = !(qx > 0.0) ? 0u : static_cast<uint32_t>(std::min(qx, cells - 1.0));
+            uint32_t cy = !(qy > 0.0) ? 0u : static_cast<uint32_t>(std::min(qy, cells - 1.0));
+            keys[i] = (spreadBits(cx << shift) | (spreadBits(cy << shift) << 1)) >> (2 * shift);
+        }
+    });
+}
+
+float PhysicsWorld::localityDisorder() {
+    size_t n = objects.size();
+    if (n < 2) return 0.0f;
+    int bits = 1;
+    while (bits < 16 && (size_t(16) << (2 * bits)) < n) ++bits;
+    StepArena::Scope scratch(stepArena);
+    Span<uint32_t> keys = stepArena.allocate<uint32_t>(n);
+    mortonKeys(keys, bits);
+    size_t descents = 0;
+    for (size_t i = 1; i < n; ++i) {
+        if (keys[i] < keys[i - 1]) ++descents;
+    }
+    return static_cast<float>(descents) / static_cast<float>(n - 1);
+}
+
+void PhysicsWorld::reorderForLocality() {
+    size_t n = objects.size();
+    if (n < 2) return;
+    StepArena::Scope scratch(stepArena);
+    Span<uint32_t> keys = stepArena.allocate<uint32_t>(n);
+    mortonKeys(keys, 16);
+    // Key above index, so equal keys keep their relative order
+    Span<uint64_t> order = stepArena.allocate<uint64_t>(n);
+    for (size_t i = 0; i < n; ++i) order[i] = (static_cast<uint64_t>(keys[i]) << 32) | i;
+    std::sort(order.begin(), order.end());
+    reorderRemap.resize(n);
+    for (size_t k = 0; k < n; ++k) reorderRemap[static_cast<uint32_t>(order[k])] = static_cast<uint32_t>(k);
+
+    // Slot k takes the object at order[k]; follow each cycle of the
+    // permutation so every object is moved once and capacity is kept
+    Span<uint8_t> placed = stepArena.allocate<uint8_t>(n);
+    for (size_t start = 0; start < n; ++start) {
+        if (placed[start]) continue;
+        PhysicsObject held = std::move(objects[start]);
+        size_t k = start;
+        for (;;) {
+            placed[k] = 1;
+            size_t from = static_cast<uint32_t>(order[k]);
+            if (from == start) {
+                objects[k] = std::move(held);
+                break;
+            }
+            objects[k] = std::move(objects[from]);
+            k = from;
+        }
+    }
+
+    auto remap = [&](PhysicsObject& obj) {
+        if (obj.orbitTarget >= 0 && static_cast<size_t>(obj.orbitTarget) < n) {
+            obj.orbitTarget = static_cast<int>(reorderRemap[obj.orbitTarget]);
+        }
+    };
+    for (auto& obj : objects) {
+        remap(obj);
+        for (auto& c : obj.components) remap(c);
+    }
+    invalidateNeighbours();
+    gridBuilt = false;
+    history.forceKeyframe();
+    ++revision;
+    ++reorderCount;
+}
+
+void PhysicsWorld::rebaseOrigin(double worldX, double worldY) {
+    Real dx = static_cast<Real>(worldX - originX);
+    Real dy = static_cast<Real>(worldY - originY);
+    if (dx == 0 && dy == 0) return;
+    for (auto& obj : objects) {
+        obj.x -= dx;
+        obj.y -= dy;
+        for (auto& c : obj.components) {
+            c.x -= dx;
+            c.y -= dy;
+        }
+    }
+    shiftFrameState(dx, dy);
+    originX = worldX;
+    originY = worldY;
+}
+
+void PhysicsWorld::shiftFrameState(Real dx, Real dy) {
+    left -= dx; right -= dx;
+    bottom -= dy; top -= dy;
+    for (auto& field : forceFields) {
+        field.x -= dx;
+        field.y -= dy;
+    }
+    trails.translate(static_cast<float>(dx), static_cast<float>(dy));
+    forceFieldsDirty = true;
+    gridBuilt = false;
+    ++revision;
+}
+
+void PhysicsWorld::ensureSpatialGrid() {
+    // step() bumps revision after its last grid build, so this rebuilds once per stepped frame
+    if (!gridBuilt || gridOpen != openBoundary || gridRevision != revision || gridObjectCount != objects.size()) {
+        updateSpatialGrid();
+    }
+}
+
+float PhysicsWorld::gridDrift() const {
+    if (!gridBuilt || gridOpen != openBoundary || gridObjectCount != objects.size()) return -1.0f;
+    float cell;
+    if (openBoundary) {
+        cell = hashGrid.cellSize();
+    } else {
+        if (gridShape[0] != gridRows || gridShape[1] != gridCols || gridWalls[0] != left || gridWalls[1] != right
+            || gridWalls[2] != bottom || gridWalls[3] != top) {
+            return -1.0f;
+        }
+        cell = std::min(cellWidth, cellHeight);
+    }
+    const Real limitSq = Real(0.25f * cell * cell);
+    Real driftSq = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        Real dx = objects[i].x - gridX[i];
+        Real dy = objects[i].y - gridY[i];
+        Real d = dx * dx + dy * dy;
+        // Negated so a non-finite position forces a rebuild
+        if (!(d <= limitSq)) return -1.0f;
+        driftSq = std::max(driftSq, d);
+    }
+    // Rounded up so the widened query cannot fall short of the drift
+    return std::nextafter(static_cast<float>(std::sqrt(driftSq)), std::numeric_limits<float>::infinity());
+}
+
 void PhysicsWorld::updateSpatialGrid() {
+    gridBuilt = true;
+    gridOpen = openBoundary;
+    gridRevision = revision;
+    gridObjectCount = objects.size();
+    gridWalls = {{left, right, bottom, top}};
+    gridShape[0] = gridRows;
+    gridShape[1] = gridCols;
+    gridMaxExtent = 0.0f;
+    float maxRadius = 0.0f;
+    gridX.resize(objects.size());
+    gridY.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const auto& obj = objects[i];
+        maxRadius = std::max(maxRadius, obj.radius);
+        gridMaxExtent = std::max(gridMaxExtent, std::max(obj.radius, obj.eventHorizon));
+        gridX[i] = obj.x;
+        gridY[i] = obj.y;
+    }
+    if (openBoundary) {
+        // Cells at least one diameter wide so the 3x3 neighbourhood covers every contact
+        hashGrid.build(objects, std::max(hashCellSize, 2.0f * maxRadius));
+        gridCellStart.clear();
+        gridCellItems.clear();
+        return;
+    }
     cellWidth = (right - left) / gridCols;
     cellHeight = (top - bottom) / gridRows;
-    gridCells.assign(gridRows, std::vector<std::vector<size_t>>(gridCols));
+    // Counting sort by cell into the flat arrays, which keep their capacity
+    size_t cellCount = static_cast<size_t>(gridRows) * gridCols;
+    StepArena::Scope scratch(stepArena);
+    Span<uint32_t> cellOf = stepArena.allocate<uint32_t>(objects.size());
+    gridCellStart.assign(cellCount + 1, 0);
     for (size_t i = 0; i < objects.size(); ++i) {
         const auto& obj = objects[i];
         int col = static_cast<int>((obj.x - left) / cellWidth);
         int row = static_cast<int>((obj.y - bottom) / cellHeight);
         col = std::max(0, std::min(gridCols - 1, col));
         row = std::max(0, std::min(gridRows - 1, row));
-        gridCells[row][col].push_back(i);
+        cellOf[i] = static_cast<uint32_t>(row * gridCols + col);
+        ++gridCellStart[cellOf[i] + 1];
+    }
+    for (size_t c = 0; c < cellCount; ++c) gridCellStart[c + 1] += gridCellStart[c];
+    gridCellItems.resize(objects.size());
+    Span<uint32_t> filled = stepArena.allocate<uint32_t>(cellCount);
+    for (size_t i = 0; i < objects.size(); ++i) {
+        uint32_t c = cellOf[i];
+        gridCellItems[gridCellStart[c] + filled[c]++] = i;
     }
 }
\ No newline at end of file
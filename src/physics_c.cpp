@@ -0,0 +1,222 @@
+#include "physics_c.h"
+#include "physics.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+#include <vector>
+
+struct phys_world {
+    PhysicsWorld world;
+    std::unique_ptr<ThreadPool> ownPool;
+};
+
+// The view hands out pointers to these members directly
+static_assert(sizeof(ObjectType) == sizeof(int32_t), "phys_view::type aliases ObjectType");
+static_assert(static_cast<int>(ObjectType::RockyPlanet) == PHYS_TYPE_ROCKY_PLANET, "PHYS_TYPE_* numbering");
+static_assert(static_cast<int>(ForceField::CUSTOM) == PHYS_FIELD_CUSTOM, "PHYS_FIELD_* numbering");
+
+namespace {
+
+Particle toParticle(const phys_body& body) {
+    Particle p;
+    p.x = static_cast<Real>(body.x);
+    p.y = static_cast<Real>(body.y);
+    p.vx = static_cast<Real>(body.vx);
+    p.vy = static_cast<Real>(body.vy);
+    p.radius = body.radius;
+    p.mass = body.mass;
+    p.isStatic = body.is_static != 0;
+    p.type = body.type >= 0 && body.type <= PHYS_TYPE_ROCKY_PLANET ? static_cast<ObjectType>(body.type)
+                                                                    : ObjectType::Normal;
+    bool hasTemperature = body.temperature > 0.0f;
+    if (hasTemperature) p.temperature = body.temperature;
+    ParticleUtils::applyTypeDefaults(p, false, hasTemperature);
+    return p;
+}
+
+}
+
+int phys_abi_version(void) {
+    return PHYS_ABI_VERSION;
+}
+
+int phys_real_bytes(void) {
+    return static_cast<int>(sizeof(Real));
+}
+
+phys_world* phys_create(size_t threads) {
+    phys_world* handle = new phys_world;
+    if (threads > 0) {
+        handle->ownPool.reset(new ThreadPool(threads));
+        handle->world.threadPool = handle->ownPool.get();
+    }
+    return handle;
+}
+
+void phys_destroy(phys_world* world) {
+    delete world;
+}
+
+size_t phys_add_bodies(phys_world* world, const phys_body* bodies, size_t count, int reject_overlaps) {
+    if (!world || !bodies || count == 0) return 0;
+    PhysicsWorld& w = world->world;
+    if (reject_overlaps) {
+        std::vector<Particle> batch(count);
+        w.pool().parallelFor(count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) batch[i] = toParticle(bodies[i]);
+        }, 4096);
+        return w.addObjects(batch, OverlapPolicy::Reject);
+    }
+    Span<PhysicsObject> out = w.appendObjects(count);
+    w.pool().parallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) out[i] = toParticle(bodies[i]);
+    }, 4096);
+    return count;
+}
+
+void phys_reserve(phys_world* world, size_t count) {
+    if (world) world->world.reserve(count);
+}
+
+void phys_clear(phys_world* world) {
+    if (!world) return;
+    world->world.clearObjects();
+    world->world.stats.reset();
+}
+
+size_t phys_body_count(const phys_world* world) {
+    return world ? world->world.objects.size() : 0;
+}
+
+void phys_step(phys_world* world, float dt) {
+    if (world) world->world.step(dt);
+}
+
+uint64_t phys_state_hash(const phys_world* world) {
+    return world ? world->world.stateHash() : 0;
+}
+
+void phys_reseed(phys_world* world, uint64_t seed) {
+    if (world) world->world.reseed(seed);
+}
+
+int phys_set_param(phys_world* world, phys_param param, double value) {
+    if (!world) return 0;
+    PhysicsWorld& w = world->world;
+    float f = static_cast<float>(value);
+    bool on = value != 0.0;
+    switch (param) {
+        case PHYS_PARAM_GRAVITY: w.gravity = f; break;
+        case PHYS_PARAM_G: w.G = value; break;
+        case PHYS_PARAM_RESTITUTION: w.restitution = f; break;
+        case PHYS_PARAM_AIR_DRAG: w.airDragCoefficient = f; break;
+        case PHYS_PARAM_GRAVITY_THETA: w.gravityTheta = f; break;
+        case PHYS_PARAM_LEFT: w.left = f; break;
+        case PHYS_PARAM_RIGHT: w.right = f; break;
+        case PHYS_PARAM_BOTTOM: w.bottom = f; break;
+        case PHYS_PARAM_TOP: w.top = f; break;
+        case PHYS_PARAM_OPEN_BOUNDARY: w.openBoundary = on; break;
+        case PHYS_PARAM_MAX_SUBSTEPS: w.maxSubsteps = value > 0.0 ? static_cast<int>(value) : 0; break;
+        case PHYS_PARAM_ALLOW_SLEEPING: w.allowSleeping = on; break;
+        case PHYS_PARAM_DETERMINISTIC: w.deterministic = on; break;
+        case PHYS_PARAM_FAST_MATH: w.fastMath = on; break;
+        case PHYS_PARAM_REORDER: w.reorderObjects = on; break;
+        case PHYS_PARAM_NEIGHBOUR_SKIN: w.neighbourSkin = f; break;
+        case PHYS_PARAM_HASH_CELL_SIZE: w.hashCellSize = f; break;
+        case PHYS_PARAM_GRID_ROWS: w.gridRows = value > 1.0 ? static_cast<int>(value) : 1; break;
+        case PHYS_PARAM_GRID_COLS: w.gridCols = value > 1.0 ? static_cast<int>(value) : 1; break;
+        default: return 0;
+    }
+    return 1;
+}
+
+int phys_get_param(const phys_world* world, phys_param param, double* value) {
+    if (!world || !value) return 0;
+    const PhysicsWorld& w = world->world;
+    switch (param) {
+        case PHYS_PARAM_GRAVITY: *value = w.gravity; break;
+        case PHYS_PARAM_G: *value = w.G; break;
+        case PHYS_PARAM_RESTITUTION: *value = w.restitution; break;
+        case PHYS_PARAM_AIR_DRAG: *value = w.airDragCoefficient; break;
+        case PHYS_PARAM_GRAVITY_THETA: *value = w.gravityTheta; break;
+        case PHYS_PARAM_LEFT: *value = w.left; break;
+        case PHYS_PARAM_RIGHT: *value = w.right; break;
+        case PHYS_PARAM_BOTTOM: *value = w.bottom; break;
+        case PHYS_PARAM_TOP: *value = w.top; break;
+        case PHYS_PARAM_OPEN_BOUNDARY: *value = w.openBoundary; break;
+        case PHYS_PARAM_MAX_SUBSTEPS: *value = w.maxSubsteps; break;
+        case PHYS_PARAM_ALLOW_SLEEPING: *value = w.allowSleeping; break;
+        case PHYS_PARAM_DETERMINISTIC: *value = w.deterministic; break;
+        case PHYS_PARAM_FAST_MATH: *value = w.fastMath; break;
+        case PHYS_PARAM_REORDER: *value = w.reorderObjects; break;
+        case PHYS_PARAM_NEIGHBOUR_SKIN: *value = w.neighbourSkin; break;
+        case PHYS_PARAM_HASH_CELL_SIZE: *value = w.hashCellSize; break;
+        case PHYS_PARAM_GRID_ROWS: *value = w.gridRows; break;
+        case PHYS_PARAM_GRID_COLS: *value = w.gridCols; break;
+        default: return 0;
+    }
+    return 1;
+}
+
+int phys_add_force_field(phys_world* world, const phys_force_field* field) {
+    if (!world || !field) return -1;
+    if (field->type < PHYS_FIELD_RADIAL || field->type > PHYS_FIELD_CUSTOM) return -1;
+    if (field->type == PHYS_FIELD_CUSTOM && !field->fn) return -1;
+    ForceField f;
+    f.type = static_cast<ForceField::Type>(field->type);
+    f.x = field->x;
+    f.y = field->y;
+    f.strength = field->strength;
+    f.radius = field->radius;
+    f.angle = field->angle;
+    f.active = field->active != 0;
+    if (field->type == PHYS_FIELD_CUSTOM) {
+        phys_field_fn fn = field->fn;
+        void* user = field->user;
+        f.customBatch = [fn, user](const ForceField&, Span<const float> x, Span<const float> y,
+                                   Span<float> vx, Span<float> vy) {
+            fn(user, x.data(), y.data(), vx.data(), vy.data(), x.size());
+        };
+    }
+    world->world.addForceField(f);
+    return static_cast<int>(world->world.forceFields.size() - 1);
+}
+
+int phys_remove_force_field(phys_world* world, size_t index) {
+    if (!world || index >= world->world.forceFields.size()) return 0;
+    world->world.removeForceField(index);
+    return 1;
+}
+
+int phys_set_force_field_active(phys_world* world, size_t index, int active) {
+    if (!world || index >= world->world.forceFields.size()) return 0;
+    world->world.setForceFieldActive(index, active != 0);
+    return 1;
+}
+
+void phys_clear_force_fields(phys_world* world) {
+    if (world) world->world.clearForceFields();
+}
+
+int phys_get_view(const phys_world* world, phys_view* view) {
+    if (!world || !view) return 0;
+    const PhysicsWorld& w = world->world;
+    *view = phys_view();
+    view->count = w.objects.size();
+    view->stride = sizeof(Particle);
+    view->real_bytes = static_cast<int32_t>(sizeof(Real));
+    if (view->count > 0) {
+        const Particle& first = w.objects.front();
+        view->x = &first.x;
+        view->y = &first.y;
+        view->vx = &first.vx;
+        view->vy = &first.vy;
+        view->mass = &first.mass;
+        view->radius = &first.radius;
+        view->type = reinterpret_cast<const int32_t*>(&first.type);
+    }
+    view->origin_x = w.originX;
+    view->origin_y = w.originY;
+    view->step = w.stepCount;
+    view->revision = w.revision;
+    return 1;
+}
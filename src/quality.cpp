@@ -0,0 +1,124 @@
+#include "quality.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+// Frames to wait after a change before judging it, and of headroom before
+// a restore; restoring needs the average under this fraction of the budget
+const int kCooldownFrames = 15;
+const int kCalmFrames = 60;
+const double kRestoreFraction = 0.6;
+
+// Degraded first to last within each group
+const QualityController::Knob kStepKnobs[] = {
+    QualityController::TreeTheta, QualityController::SubstepCap, QualityController::TrailDecimation};
+const QualityController::Knob kViewKnobs[] = {
+    QualityController::Diagnostics, QualityController::FieldResolution};
+} // namespace
+
+const char* QualityController::knobName(Knob knob) {
+    switch (knob) {
+        case TreeTheta: return "Tree Opening Angle";
+        case SubstepCap: return "Substep Cap";
+        case TrailDecimation: return "Trail Decimation";
+        case FieldResolution: return "Field Resolution";
+        case Diagnostics: return "Diagnostics Refresh";
+        case KnobCount: break;
+    }
+    return "Unknown";
+}
+
+QualitySettings QualityController::apply(const QualitySettings& preferred) const {
+    QualitySettings q = preferred;
+    if (int l = levels[TreeTheta]) {
+        float worst = std::max(limits.treeTheta, preferred.treeTheta);
+        q.treeTheta = preferred.treeTheta + (worst - preferred.treeTheta) * l / maxLevel;
+    }
+    if (int l = levels[SubstepCap]) {
+        // 16, 8, 4, 2 substeps at most, never more than the user allows
+        q.substepCap = std::max(32 >> l, std::max(limits.substepCap, 1));
+        if (preferred.substepCap > 0) q.substepCap = std::min(q.substepCap, preferred.substepCap);
+    }
+    if (int l = levels[TrailDecimation]) {
+        uint32_t worst = std::max(limits.trailDecimation, preferred.trailDecimation);
+        q.trailDecimation = std::min(worst, std::max(preferred.trailDecimation, 1u) << l);
+    }
+    if (int l = levels[FieldResolution]) {
+        int worst = std::min(limits.fieldResolution, preferred.fieldResolution);
+        q.fieldResolution = preferred.fieldResolution - (preferred.fieldResolution - worst) * l / maxLevel;
+    }
+    if (int l = levels[Diagnostics]) {
+        int worst = std::max(limits.diagnosticsInterval, preferred.diagnosticsInterval);
+        q.diagnosticsInterval = std::min(worst, std::max(preferred.diagnosticsInterval, 1) << (2 * l));
+    }
+    return q;
+}
+
+void QualityController::reset() {
+    std::fill(levels, levels + KnobCount, 0);
+    for (auto& r : reasons) r[0] = '\0';
+    degradedCount = 0;
+    stepCooldown = viewCooldown = 0;
+    stepCalm = viewCalm = 0;
+}
+
+bool QualityController::degrade(const QualitySettings& preferred, Knob knob) {
+    if (levels[knob] >= maxLevel) return false;
+    // Skip levels the limits make no different from the current one
+    QualitySettings before = apply(preferred);
+    ++levels[knob];
+    QualitySettings after = apply(preferred);
+    if (std::memcmp(&before, &after, sizeof(QualitySettings)) == 0) {
+        --levels[knob];
+        return false;
+    }
+    degraded[degradedCount++] = knob;
+    return true;
+}
+
+void QualityController::control(const QualitySettings& preferred, const Knob* knobs, int count, double ms,
+                                float budget, const char* what, double& average, int& cooldown, int& calm) {
+    average = ms > 2.0 * budget ? ms : average * 0.8 + ms * 0.2;
+    if (cooldown > 0) {
+        --cooldown;
+        return;
+    }
+    if (average > budget) {
+        calm = 0;
+        // Least degraded knob first, in group order on ties
+        Knob order[KnobCount];
+        std::copy(knobs, knobs + count, order);
+        std::stable_sort(order, order + count, [&](Knob a, Knob b) { return levels[a] < levels[b]; });
+        for (int k = 0; k < count; ++k) {
+            if (!degrade(preferred, order[k])) continue;
+            std::snprintf(reasons[order[k]], sizeof(reasons[0]), "%s %.1f ms > %.1f ms budget", what, average,
+                          budget);
+            cooldown = kCooldownFrames;
+            return;
+        }
+        return;
+    }
+    if (average > kRestoreFraction * budget || ++calm < kCalmFrames) return;
+    calm = 0;
+    for (int d = degradedCount - 1; d >= 0; --d) {
+        Knob knob = degraded[d];
+        if (std::find(knobs, knobs + count, knob) == knobs + count) continue;
+        std::copy(degraded + d + 1, degraded + degradedCount, degraded + d);
+        --degradedCount;
+        if (--levels[knob] == 0) reasons[knob][0] = '\0';
+        cooldown = kCooldownFrames;
+        return;
+    }
+}
+
+void QualityController::update(const QualitySettings& preferred, double stepMs, double viewMs) {
+    if (!enabled) {
+        if (degradedCount > 0) reset();
+        return;
+    }
+    if (stepMs >= 0.0) {
+        control(preferred, kStepKnobs, 3, stepMs, stepBudgetMs, "step", stepAverage, stepCooldown, stepCalm);
+    }
+    control(preferred, kViewKnobs, 2, viewMs, viewBudgetMs, "view", viewAverage, viewCooldown, viewCalm);
+}
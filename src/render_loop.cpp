@@ -4,10 +4,11 @@
 #include <vector>
 #include <cstdio>
 #include <cmath>
+#include <algorithm>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-void renderLoop(GLFWwindow* window, GLuint gridProgram, GLuint gridVAO, int gridVertexCount, GLuint axisProgram, GLuint axisVAO, int axisVertexCount, GridRenderer& gridRenderer, PhysicsWorld& world, GLuint pointProgram) {
+void renderLoop(GLFWwindow* window, GLuint gridProgram, GLuint gridVAO, int gridVertexCount, GLuint axisProgram, GLuint axisVAO, int axisVertexCount, GridRenderer& gridRenderer, ParticleRenderer& particleRenderer, LineBatch& lines, const Camera2D& camera, PhysicsWorld& world) {
     // Debug: Print each frame to confirm rendering
     static int frameCount = 0;
     if (frameCount++ % 60 == 0) {
@@ -26,137 +27,88 @@ void renderLoop(GLFWwindow* window, GLuint gridProgram, GLuint gridVAO, int grid
     glEnable(GL_BLEND);
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    float view[4];
+    camera.viewUniform(view);
+    float minX, minY, maxX, maxY;
+    camera.viewRect(minX, minY, maxX, maxY);
+    lines.setView(camera);
     GLint colorLoc = glGetUniformLocation(axisProgram, "color");
-    static GLint pointColorLoc = -1;
     // Draw axes in red
     glUseProgram(axisProgram);
     glUniform3f(colorLoc, 0.8f, 0.0f, 0.0f);
+    glUniform4fv(glGetUniformLocation(axisProgram, "view"), 1, view);
     gridRenderer.drawAxes(axisProgram, axisVAO, axisVertexCount);
-    // Draw field (field arrows set their own color)
-    gridRenderer.drawField(world, axisProgram, colorLoc);
-    // Draw physics objects as circular points (point masses) in red
-    glUseProgram(pointProgram);
-    if (pointColorLoc == -1) pointColorLoc = glGetUniformLocation(pointProgram, "color");
-    float minMass, maxMass;
-    ParticleUtils::computeMassRange(world.objects, minMass, maxMass);
-    for (size_t i = 0; i < world.objects.size(); ++i) {
-        const auto& obj = world.objects[i];
-        Color3 color = obj.color;
-        float size = obj.radius * 600.0f;
-        bool customDraw = false;
-        // --- Visual rotation: draw orientation marker if spinAngle is nonzero ---
-        auto drawOrientationMarker = [&](const Particle& p, float markerLen, float markerWidth, const Color3& markerColor) {
-            if (std::abs(p.spin) > 1e-6f || std::abs(p.spinAngle) > 1e-6f) {
-                float angle = p.spinAngle;
-                float x1 = p.x + std::cos(angle) * (p.radius + markerLen);
-                float y1 = p.y + std::sin(angle) * (p.radius + markerLen);
-                float x0 = p.x + std::cos(angle) * p.radius;
-                float y0 = p.y + std::sin(angle) * p.radius;
-                glUseProgram(axisProgram);
-                glUniform3f(colorLoc, markerColor.r, markerColor.g, markerColor.b);
-                glLineWidth(markerWidth);
-                glBegin(GL_LINES);
-                glVertex2f(x0, y0);
-                glVertex2f(x1, y1);
-                glEnd();
-                glLineWidth(1.0f);
-            }
+    // Objects that can touch the view: the grid gives the candidates, the margin
+    // covers the widest sprite (star glow, event horizon, spin marker)
+    static std::vector<size_t> visible;
+    world.ensureSpatialGrid();
+    float maxRadius = world.gridMaxRadius();
+    float spritePx = 1200.0f * maxRadius * camera.zoom + 2.0f;
+    float margin = std::max(2.2f * maxRadius, spritePx / (std::max(1, std::min(fbWidth, fbHeight)) * camera.zoom));
+    world.queryRect(minX, minY, maxX, maxY, margin, visible);
+    // Field arrows and trails go underneath the objects
+    gridRenderer.drawField(world, camera, lines);
+    const TrailPool& trails = world.trails;
+    const float* trailPoints = trails.data();
+    for (const auto& obj : world.objects) {
+        if (!trails.valid(obj.trail)) continue;
+        const Trail& t = trails.trail(obj.trail);
+        if (t.count < 2 || !t.mayTouch(minX, minY, maxX, maxY)) continue;
+        // Oldest point first; fade in towards the head
+        uint32_t first0, count0, first1, count1;
+        t.ranges(first0, count0, first1, count1);
+        auto pointAt = [&](uint32_t k) {
+            return k < count0 ? first0 + k : first1 + (k - count0);
         };
-        // Visually distinct rendering for each type
+        for (uint32_t k = 1; k < t.count; ++k) {
+            uint32_t p0 = pointAt(k - 1), p1 = pointAt(k);
+            float x0 = trailPoints[p0 * 2], y0 = trailPoints[p0 * 2 + 1];
+            float x1 = trailPoints[p1 * 2], y1 = trailPoints[p1 * 2 + 1];
+            // Skip segments entirely off one side of the view
+            if ((x0 < minX && x1 < minX) || (x0 > maxX && x1 > maxX) ||
+                (y0 < minY && y1 < minY) || (y0 > maxY && y1 > maxY)) continue;
+            float a0 = 0.6f * (k - 1) / t.count;
+            float a1 = 0.6f * k / t.count;
+            lines.addLine(x0, y0, obj.color, a0, x1, y1, obj.color, a1);
+        }
+    }
+    lines.flush();
+    // Draw all physics objects in one instanced call; per-type looks are in the shader
+    particleRenderer.draw(world, visible, camera, fbWidth, fbHeight);
+    // --- Visual rotation: orientation marker for spinning objects ---
+    auto drawOrientationMarker = [&](const Particle& p, float markerLen, float markerWidth, const Color3& markerColor) {
+        if (std::abs(p.spin) > 1e-6f || std::abs(p.spinAngle) > 1e-6f) {
+            float c = std::cos(p.spinAngle);
+            float s = std::sin(p.spinAngle);
+            float x1 = p.x + c * (p.radius + markerLen);
+            float y1 = p.y + s * (p.radius + markerLen);
+            float x0 = p.x + c * p.radius;
+            float y0 = p.y + s * p.radius;
+            lines.addLine(x0, y0, x1, y1, markerColor, 1.0f, markerWidth);
+        }
+    };
+    for (size_t i : visible) {
+        const auto& obj = world.objects[i];
         switch (obj.type) {
             case ObjectType::BlackHole:
-                // Draw event horizon as a thick dark ring
-                glUseProgram(pointProgram);
-                glUniform3f(pointColorLoc, 0.1f, 0.1f, 0.1f);
-                glPointSize(obj.eventHorizon * 1200.0f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
-                // Draw core as a smaller dark circle
-                glUniform3f(pointColorLoc, 0.2f, 0.2f, 0.2f);
-                glPointSize(obj.radius * 600.0f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
-                // Draw orientation marker for spin
                 drawOrientationMarker(obj, obj.radius * 0.7f, 3.0f, {0.8f, 0.2f, 0.2f});
-                customDraw = true;
                 break;
             case ObjectType::Star:
-                // Draw a glowing star (core + outer glow)
-                glUseProgram(pointProgram);
-                glUniform3f(pointColorLoc, color.r, color.g, color.b);
-                glPointSize(size * 2.0f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
-                glUniform3f(pointColorLoc, 1.0f, 1.0f, 0.6f);
-                glPointSize(size * 1.2f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
-                glUniform3f(pointColorLoc, color.r, color.g, color.b);
-                glPointSize(size);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
                 drawOrientationMarker(obj, obj.radius * 1.2f, 2.0f, {1.0f, 0.8f, 0.2f});
-                customDraw = true;
                 break;
             case ObjectType::Planet:
-                // Draw planet with a colored ring for orbit
-                glUseProgram(pointProgram);
-                glUniform3f(pointColorLoc, 0.7f, 0.7f, 0.7f);
-                glPointSize(size * 1.5f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
-                glUniform3f(pointColorLoc, color.r, color.g, color.b);
-                glPointSize(size);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
                 drawOrientationMarker(obj, obj.radius * 1.1f, 2.0f, {0.2f, 0.8f, 1.0f});
-                customDraw = true;
                 break;
             case ObjectType::Asteroid:
-                // Draw asteroid as a small brown/gray point
-                glUseProgram(pointProgram);
-                glUniform3f(pointColorLoc, color.r * 0.7f, color.g * 0.6f, color.b * 0.5f);
-                glPointSize(size * 0.8f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
                 drawOrientationMarker(obj, obj.radius * 0.7f, 1.5f, {0.7f, 0.7f, 0.7f});
-                customDraw = true;
                 break;
             case ObjectType::Merged:
-                // Draw merged as cyan with a white outline
-                glUseProgram(pointProgram);
-                glUniform3f(pointColorLoc, 1.0f, 1.0f, 1.0f);
-                glPointSize(size * 1.3f);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
-                glUniform3f(pointColorLoc, 0.2f, 0.8f, 1.0f);
-                glPointSize(size);
-                glBegin(GL_POINTS);
-                glVertex2f(obj.x, obj.y);
-                glEnd();
                 drawOrientationMarker(obj, obj.radius * 1.0f, 2.0f, {0.2f, 1.0f, 1.0f});
-                customDraw = true;
                 break;
             default:
+                drawOrientationMarker(obj, obj.radius * 1.0f, 2.0f, {1.0f, 1.0f, 1.0f});
                 break;
         }
-        if (!customDraw) {
-            glUseProgram(pointProgram);
-            glUniform3f(pointColorLoc, color.r, color.g, color.b);
-            glPointSize(size);
-            glBegin(GL_POINTS);
-            glVertex2f(obj.x, obj.y);
-            glEnd();
-            drawOrientationMarker(obj, obj.radius * 1.0f, 2.0f, {1.0f, 1.0f, 1.0f});
-        }
     }
+    lines.flush();
 }
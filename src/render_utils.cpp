@@ -23,10 +23,12 @@ void generateGridVertices(std::vector<float>& vertices, int N) {
 }
 
 void generateAxisVertices(std::vector<float>& vertices) {
-    vertices.push_back(-1.0f); vertices.push_back(0.0f);
-    vertices.push_back( 1.0f); vertices.push_back(0.0f);
-    vertices.push_back(0.0f); vertices.push_back(-1.0f);
-    vertices.push_back(0.0f); vertices.push_back( 1.0f);
+    // World-space axes, long enough to span the view at the camera's minimum zoom
+    const float extent = 1000.0f;
+    vertices.push_back(-extent); vertices.push_back(0.0f);
+    vertices.push_back( extent); vertices.push_back(0.0f);
+    vertices.push_back(0.0f); vertices.push_back(-extent);
+    vertices.push_back(0.0f); vertices.push_back( extent);
 }
 
 void setupVAOandVBO(GLuint& VAO, GLuint& VBO, const std::vector<float>& vertices) {
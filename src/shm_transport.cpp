@@ -0,0 +1,177 @@
+#include "transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory barrier needs address-free atomics");
+
+namespace {
+struct Layout {
+    uint32_t magic;
+    uint32_t ranks;
+    uint64_t capacity;
+};
+} // namespace
+
+struct ShmTransport::Header {
+    Layout layout;
+    std::atomic<uint32_t> arrived;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> failed;    // sticky once any message overflowed
+};
+
+namespace {
+const uint32_t kShmMagic = 0x50484d53; // "PHMS"
+const size_t kHeaderBytes = 128;
+
+size_t slotBytes(size_t capacity) { return (sizeof(uint64_t) + capacity + 63) & ~size_t(63); }
+size_t segmentBytes(int ranks, size_t capacity) {
+    return kHeaderBytes + 2 * static_cast<size_t>(ranks) * ranks * slotBytes(capacity);
+}
+} // namespace
+
+#ifndef _WIN32
+
+std::unique_ptr<ShmTransport> ShmTransport::create(const char* name, int ranks, size_t capacity) {
+    static_assert(sizeof(Header) <= kHeaderBytes, "header overlaps the first mailbox");
+    if (ranks < 1) return nullptr;
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    size_t bytes = segmentBytes(ranks, capacity);
+    // Sparse: pages are only backed once a mailbox is written
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return nullptr;
+    }
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(name);
+        return nullptr;
+    }
+    std::unique_ptr<ShmTransport> t(new ShmTransport());
+    t->base = static_cast<unsigned char*>(mapped);
+    t->mappedBytes = bytes;
+    t->header = new (mapped) Header();
+    t->header->layout.ranks = static_cast<uint32_t>(ranks);
+    t->header->layout.capacity = capacity;
+    t->header->arrived.store(0);
+    t->header->generation.store(0);
+    t->header->failed.store(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    t->header->layout.magic = kShmMagic;
+    t->ranks = ranks;
+    t->capacity = capacity;
+    return t;
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::attach(const char* name, int rank) {
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    Layout probe;
+    void* head = mmap(nullptr, kHeaderBytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (head == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    std::memcpy(&probe, head, sizeof(probe));
+    munmap(head, kHeaderBytes);
+    if (probe.magic != kShmMagic || rank < 0 || rank >= static_cast<int>(probe.ranks)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t bytes = segmentBytes(static_cast<int>(probe.ranks), probe.capacity);
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return nullptr;
+    std::unique_ptr<ShmTransport> t(new ShmTransport());
+    t->base = static_cast<unsigned char*>(mapped);
+    t->mappedBytes = bytes;
+    t->header = static_cast<Header*>(mapped);
+    t->me = rank;
+    t->ranks = static_cast<int>(probe.ranks);
+    t->capacity = probe.capacity;
+    return t;
+}
+
+void ShmTransport::unlink(const char* name) {
+    shm_unlink(name);
+}
+
+ShmTransport::~ShmTransport() {
+    if (base) munmap(base, mappedBytes);
+}
+
+#else
+
+// Shared memory here is POSIX only; a Windows port would map a named
+// CreateFileMapping section the same way
+std::unique_ptr<ShmTransport> ShmTransport::create(const char*, int, size_t) { return nullptr; }
+std::unique_ptr<ShmTransport> ShmTransport::attach(const char*, int) { return nullptr; }
+void ShmTransport::unlink(const char*) {}
+ShmTransport::~ShmTransport() = default;
+
+#endif
+
+unsigned char* ShmTransport::mailbox(uint64_t set, int from, int to) const {
+    size_t index = (static_cast<size_t>(set) * ranks + from) * ranks + to;
+    return base + kHeaderBytes + index * slotBytes(capacity);
+}
+
+bool ShmTransport::barrier() {
+    // Sense-reversing: the last rank to arrive resets the count and bumps
+    // the generation everyone else is spinning on
+    uint32_t generation = header->generation.load(std::memory_order_acquire);
+    if (header->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == static_cast<uint32_t>(ranks)) {
+        header->arrived.store(0, std::memory_order_relaxed);
+        header->generation.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned spins = 0; header->generation.load(std::memory_order_acquire) == generation; ++spins) {
+        if (spins < 64) continue;
+        std::this_thread::yield();
+        if ((spins & 1023) == 0 &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeoutSeconds) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShmTransport::exchange(const std::vector<Buffer>& outgoing, std::vector<Buffer>& incoming) {
+    uint64_t set = exchanges++ & 1;
+    for (int to = 0; to < ranks; ++to) {
+        unsigned char* slot = mailbox(set, me, to);
+        const Buffer* message = to < static_cast<int>(outgoing.size()) ? &outgoing[to] : nullptr;
+        uint64_t bytes = message ? message->size() : 0;
+        if (bytes > capacity) {
+            // Still take part in the barrier so nobody waits forever; the
+            // flag is visible to every rank once the barrier is through
+            header->failed.store(1, std::memory_order_relaxed);
+            bytes = 0;
+        }
+        std::memcpy(slot, &bytes, sizeof(uint64_t));
+        if (bytes) std::memcpy(slot + sizeof(uint64_t), message->data(), bytes);
+    }
+    if (!barrier()) return false;
+    if (header->failed.load(std::memory_order_relaxed)) return false;
+
+    incoming.resize(ranks);
+    for (int from = 0; from < ranks; ++from) {
+        const unsigned char* slot = mailbox(set, from, me);
+        uint64_t bytes;
+        std::memcpy(&bytes, slot, sizeof(uint64_t));
+        incoming[from].assign(slot + sizeof(uint64_t), slot + sizeof(uint64_t) + bytes);
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#include "spatial_hash.hpp"
+#include <algorithm>
+
+void SpatialHashGrid::clear() {
+    std::fill(slots.begin(), slots.end(), npos);
+    occupied.clear();
+    chain.clear();
+}
+
+void SpatialHashGrid::build(const std::vector<Particle>& objects, float cellSize) {
+    size = cellSize > 0.0f ? cellSize : 0.1f;
+    invSize = 1.0f / size;
+    // Start with room for one cell per object at under half load
+    size_t wanted = 16;
+    while (wanted < objects.size() * 2) wanted <<= 1;
+    if (slots.size() < wanted) slots.resize(wanted);
+    clear();
+    chain.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) insert(i, objects[i].x, objects[i].y);
+}
+
+void SpatialHashGrid::insert(size_t index, float x, float y) {
+    if (chain.size() <= index) chain.resize(index + 1, npos);
+    uint32_t& head = cellHead(cellCoord(x), cellCoord(y));
+    chain[index] = head;
+    head = static_cast<uint32_t>(index);
+}
+
+uint32_t SpatialHashGrid::find(int32_t cx, int32_t cy) const {
+    if (slots.empty()) return npos;
+    size_t mask = slots.size() - 1;
+    for (size_t s = hash(cx, cy) & mask;; s = (s + 1) & mask) {
+        uint32_t c = slots[s];
+        if (c == npos) return npos;
+        if (occupied[c].cx == cx && occupied[c].cy == cy) return occupied[c].head;
+    }
+}
+
+uint32_t& SpatialHashGrid::cellHead(int32_t cx, int32_t cy) {
+    if (slots.empty() || (occupied.size() + 1) * 2 > slots.size()) {
+        rehash(std::max<size_t>(16, slots.size() * 2));
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t s = hash(cx, cy) & mask;; s = (s + 1) & mask) {
+        uint32_t c = slots[s];
+        if (c == npos) {
+            slots[s] = static_cast<uint32_t>(occupied.size());
+            occupied.push_back({cx, cy, npos});
+            return occupied.back().head;
+        }
+        if (occupied[c].cx == cx && occupied[c].cy == cy) return occupied[c].head;
+    }
+}
+
+void SpatialHashGrid::rehash(size_t slotCount) {
+    slots.assign(slotCount, npos);
+    size_t mask = slotCount - 1;
+    for (size_t c = 0; c < occupied.size(); ++c) {
+        size_t s = hash(occupied[c].cx, occupied[c].cy) & mask;
+        while (slots[s] != npos) s = (s + 1) & mask;
+        slots[s] = static_cast<uint32_t>(c);
+    }
+}
+
+size_t SpatialHashGrid::memoryUsage() const {
+    return slots.capacity() * sizeof(uint32_t) + occupied.capacity() * sizeof(Cell)
+         + chain.capacity() * sizeof(uint32_t);
+}
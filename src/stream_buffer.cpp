@@ -0,0 +1,86 @@
+#include "stream_buffer.hpp"
+
+void StreamBuffer::init() {
+    glGenBuffers(1, &vbo);
+    persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+void StreamBuffer::waitAll() {
+    for (auto& f : fences) {
+        if (f) {
+            glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(f);
+            f = nullptr;
+        }
+    }
+}
+
+void StreamBuffer::destroy() {
+    waitAll();
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &vbo);
+    vbo = 0;
+    regionBytes = 0;
+}
+
+void StreamBuffer::reserve(size_t bytes) {
+    if (bytes <= regionBytes) return;
+    size_t newBytes = regionBytes ? regionBytes : 64 * 1024;
+    while (newBytes < bytes) newBytes *= 2;
+    regionBytes = newBytes;
+    if (!persistent) return;
+
+    // Immutable storage can't be resized: wait for the GPU, then replace it
+    waitAll();
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (mapped) glUnmapBuffer(GL_ARRAY_BUFFER);
+    glDeleteBuffers(1, &vbo);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLsizeiptr total = regionBytes * kRegions;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, total, nullptr, flags);
+    mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags));
+    if (!mapped) {
+        // Driver advertised buffer storage but refused the mapping
+        persistent = false;
+        glDeleteBuffers(1, &vbo);
+        glGenBuffers(1, &vbo);
+    }
+    region = 0;
+}
+
+void* StreamBuffer::map(size_t bytes) {
+    reserve(bytes);
+    pendingBytes = bytes;
+    if (persistent) {
+        // Don't overwrite a region the GPU may still be reading
+        GLsync& f = fences[region];
+        if (f) {
+            glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(f);
+            f = nullptr;
+        }
+        return mapped + region * regionBytes;
+    }
+    staging.resize(bytes);
+    return staging.data();
+}
+
+size_t StreamBuffer::unmap() {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (persistent) return region * regionBytes;
+    glBufferData(GL_ARRAY_BUFFER, regionBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, pendingBytes, staging.data());
+    return 0;
+}
+
+void StreamBuffer::fence() {
+    if (!persistent) return;
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % kRegions;
+}
@@ -0,0 +1,100 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static thread_local bool tlsInsideChunk = false;
+static thread_local const ThreadPool* tlsPool = nullptr;
+static thread_local size_t tlsWorker = 0;
+
+ThreadPool::ThreadPool(size_t threads, bool pinned) {
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 0) threads = cores;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+#ifdef __linux__
+        // Worker i on core i, leaving core 0 to the calling thread
+        if (pinned) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(static_cast<int>(i % cores), &set);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+        }
+#else
+        (void)pinned; // affinity is only applied on Linux
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::runChunks() {
+    bool wasInside = tlsInsideChunk;
+    tlsInsideChunk = true;
+    size_t begin;
+    while ((begin = jobNext.fetch_add(jobChunk)) < jobCount) {
+        (*jobFn)(begin, std::min(begin + jobChunk, jobCount));
+    }
+    tlsInsideChunk = wasInside;
+}
+
+size_t ThreadPool::workerIndex() const {
+    return tlsPool == this ? tlsWorker : 0;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    tlsPool = this;
+    tlsWorker = index;
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        lock.unlock();
+        runChunks();
+        lock.lock();
+        if (--jobPending == 0) done.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const RangeFn& fn, size_t grain) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    if (workers.empty() || tlsInsideChunk || count <= grain) {
+        fn(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFn = &fn;
+        jobCount = count;
+        // A few chunks per thread so uneven rows still balance
+        jobChunk = std::max(grain, count / (size() * 4));
+        jobNext.store(0);
+        jobPending = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return jobPending == 0; });
+    jobFn = nullptr;
+}
@@ -1,7 +1,11 @@
 #include "ui.hpp"
 #include "physics.hpp"
+#include "initial_conditions.hpp"
 #include <imgui.h>
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <vector>
 
 void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
     if (!world) return;
@@ -26,14 +30,68 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
         if (ImGui::Button("Step")) {
             world->step(1.0f / 60.0f);
         }
-        
+
+        // Timeline: scrub through the retained history (pauses the simulation)
+        SimulationHistory& history = world->history;
+        ImGui::Checkbox("Record History", &history.enabled);
+        if (!history.empty()) {
+            int current = static_cast<int>(world->stepCount);
+            int oldest = static_cast<int>(history.oldestStep());
+            int newest = static_cast<int>(history.newestStep());
+            if (ImGui::SliderInt("Timeline", &current, oldest, newest)) {
+                state.paused = true;
+                history.seek(static_cast<uint64_t>(current), *world);
+            }
+            ImGui::Text("History: %zu frames, %.1f MB", history.frameCount(),
+                        history.memoryUsage() / (1024.0f * 1024.0f));
+        }
+        static int historyBudgetMB = static_cast<int>(history.memoryBudget / (1024 * 1024));
+        if (ImGui::SliderInt("History Budget (MB)", &historyBudgetMB, 8, 1024)) {
+            history.memoryBudget = static_cast<size_t>(historyBudgetMB) * 1024 * 1024;
+        }
+        static int keyframeInterval = static_cast<int>(history.keyframeInterval);
+        if (ImGui::SliderInt("Keyframe Every", &keyframeInterval, 1, 600)) {
+            history.keyframeInterval = static_cast<size_t>(keyframeInterval);
+        }
+
         // NEW: Advanced physics options
         ImGui::Separator();
         ImGui::SliderFloat("Air Drag", &world->airDragCoefficient, 0.0f, 0.1f, "%.4f");
+        ImGui::SliderFloat("Restitution", &world->restitution, 0.0f, 1.0f);
         ImGui::Checkbox("Relativistic Effects", &world->relativisticEffects);
+        ImGui::SliderFloat("Tree Opening Angle", &state.treeTheta, 0.0f, 1.5f, "%.2f (0 = exact)");
+        ImGui::SliderInt("Substep Cap", &state.substepCap, 0, 64, state.substepCap ? "%d" : "none");
+        ImGui::Checkbox("Open Boundary (no walls)", &world->openBoundary);
+        ImGui::Checkbox("Auto Rebase Origin", &world->autoRebase);
+        ImGui::SameLine();
+        ImGui::Text("(%.3g, %.3g)", world->originX, world->originY);
+        if (sizeof(Real) > sizeof(float)) {
+            ImGui::Checkbox("Single-Precision Forces", &world->singlePrecisionForces);
+        }
+        ImGui::Checkbox("Fast Math Kernels", &world->fastMath);
+        ImGui::Checkbox("Reorder For Locality", &world->reorderObjects);
+        if (world->reorderObjects) {
+            ImGui::SameLine();
+            ImGui::Text("%zu reorders", world->reorderCount);
+        }
+        ImGui::Checkbox("Allow Sleeping", &world->allowSleeping);
+        if (world->allowSleeping) {
+            ImGui::SameLine();
+            ImGui::Text("%zu asleep", world->sleepingCount());
+            ImGui::SliderFloat("Sleep Speed", &world->sleepSpeed, 0.0f, 0.2f, "%.3f");
+            ImGui::SliderFloat("Sleep Energy", &world->sleepEnergy, 0.0f, 0.01f, "%.4f");
+            ImGui::SliderFloat("Time To Sleep", &world->timeToSleep, 0.05f, 3.0f, "%.2f s");
+            if (ImGui::Button("Wake All")) {
+                world->wakeAll();
+            }
+        }
+        if (world->openBoundary) {
+            ImGui::Text("Hashed cells: %zu (%.1f KB)", world->hashGrid.cells().size(),
+                        world->hashGrid.memoryUsage() / 1024.0f);
+        }
         
         if (ImGui::Button("Clear All")) {
-            world->objects.clear();
+            world->clearObjects();
             world->stats.reset();
         }
         ImGui::SameLine();
@@ -46,27 +104,141 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
     if (ImGui::CollapsingHeader("Diagnostics", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Text("Objects: %zu", world->objects.size());
         
-        float ke = world->totalKineticEnergy();
-        float pe = world->totalPotentialEnergy();
-        float total = ke + pe;
+        // The sums are O(n^2) for the potential, so they refresh every
+        // diagnosticsInterval frames
+        static int sinceRefresh = 0;
+        static float ke = 0.0f, pe = 0.0f, pMag = 0.0f, L = 0.0f;
+        if (sinceRefresh++ % std::max(state.applied.diagnosticsInterval, 1) == 0) {
+            ke = world->totalKineticEnergy();
+            pe = world->totalPotentialEnergy();
+            float px, py;
+            world->totalMomentum(px, py);
+            pMag = std::sqrt(px * px + py * py);
+            L = world->totalAngularMomentum();
+        }
         ImGui::Text("Kinetic E: %.3f", ke);
         ImGui::Text("Potential E: %.3f", pe);
-        ImGui::Text("Total E: %.3f", total);
-        
-        float px, py;
-        world->totalMomentum(px, py);
-        float pMag = std::sqrt(px * px + py * py);
+        ImGui::Text("Total E: %.3f", ke + pe);
         ImGui::Text("Momentum: %.3f", pMag);
-        
-        float L = world->totalAngularMomentum();
         ImGui::Text("Angular Mom: %.3f", L);
         
         ImGui::Separator();
         ImGui::Text("Collisions: %zu", world->stats.totalCollisions);
         ImGui::Text("Absorbed: %zu", world->stats.objectsAbsorbed);
         ImGui::Text("Energy Lost: %.3f", world->stats.totalEnergyLost);
+        
+        ImGui::Separator();
+        MemoryUsage mem = world->memoryUsage();
+        const float mb = 1.0f / (1024.0f * 1024.0f);
+        ImGui::Text("Memory: %.1f MB", mem.total() * mb);
+        ImGui::Text("  Particles %.1f  Grid %.1f  Trails %.1f", mem.particles * mb, mem.grid * mb, mem.trails * mb);
+        ImGui::Text("  History %.1f  Fields %.1f  Scratch %.1f", mem.history * mb, mem.fields * mb, mem.scratch * mb);
+        
+        ImGui::Separator();
+        ImGui::Checkbox("Deterministic Reductions", &world->deterministic);
+        ImGui::Checkbox("Hash State Each Step", &world->hashEveryStep);
+        ImGui::SameLine();
+        ImGui::Checkbox("Log", &world->logStateHash);
+        if (world->hashEveryStep || world->logStateHash) {
+            ImGui::Text("State: %016llx", static_cast<unsigned long long>(world->lastStateHash));
+        }
     }
     
+    // === QUALITY ===
+    if (ImGui::CollapsingHeader("Adaptive Quality")) {
+        QualityController& quality = state.quality;
+        ImGui::Checkbox("Hold Frame Budget", &quality.enabled);
+        ImGui::SliderFloat("Step Budget", &quality.stepBudgetMs, 1.0f, 50.0f, "%.1f ms");
+        ImGui::SliderFloat("View Budget", &quality.viewBudgetMs, 1.0f, 50.0f, "%.1f ms");
+        ImGui::Text("Step %.1f ms, view %.1f ms", quality.stepAverageMs(), quality.viewAverageMs());
+        ImGui::SliderInt("Diagnostics Every", &state.diagnosticsInterval, 1, 60, "%d frames");
+        if (ImGui::TreeNode("Limits")) {
+            QualitySettings& limits = quality.limits;
+            ImGui::SliderFloat("Max Tree Angle", &limits.treeTheta, 0.0f, 1.5f, "%.2f");
+            ImGui::SliderInt("Min Substep Cap", &limits.substepCap, 1, 16);
+            ImGui::SliderInt("Min Field Resolution", &limits.fieldResolution, 2, 100);
+            ImGui::SliderInt("Max Diagnostics Interval", &limits.diagnosticsInterval, 1, 120, "%d frames");
+            int maxDecimation = static_cast<int>(limits.trailDecimation);
+            if (ImGui::SliderInt("Max Trail Decimation", &maxDecimation, 1, 64)) {
+                limits.trailDecimation = static_cast<uint32_t>(maxDecimation);
+            }
+            ImGui::TreePop();
+        }
+        ImGui::Separator();
+        const QualitySettings& q = state.applied;
+        for (int k = 0; k < QualityController::KnobCount; ++k) {
+            auto knob = static_cast<QualityController::Knob>(k);
+            char value[32];
+            switch (knob) {
+                case QualityController::TreeTheta: snprintf(value, sizeof(value), "%.2f", q.treeTheta); break;
+                case QualityController::SubstepCap:
+                    if (q.substepCap > 0) snprintf(value, sizeof(value), "%d", q.substepCap);
+                    else snprintf(value, sizeof(value), "none");
+                    break;
+                case QualityController::TrailDecimation: snprintf(value, sizeof(value), "%u", q.trailDecimation); break;
+                case QualityController::FieldResolution: snprintf(value, sizeof(value), "%d", q.fieldResolution); break;
+                default: snprintf(value, sizeof(value), "%d frames", q.diagnosticsInterval); break;
+            }
+            int level = quality.level(knob);
+            if (level == 0) {
+                ImGui::Text("%s: %s", QualityController::knobName(knob), value);
+            } else {
+                ImGui::TextColored(ImVec4(1.0f, 0.7f, 0.2f, 1.0f), "%s: %s (level %d/%d, %s)",
+                                   QualityController::knobName(knob), value, level, QualityController::maxLevel,
+                                   quality.reason(knob));
+            }
+        }
+    }
+
+    // === EVENTS ===
+    if (ImGui::CollapsingHeader("Events")) {
+        // The log only subscribes while enabled, so a closed log costs the
+        // step nothing
+        static bool logEvents = false;
+        static int subscription = 0;
+        static bool typeEnabled[5] = {true, true, true, true, true};
+        static uint64_t counts[5] = {};
+        static std::vector<PhysicsEvent> recent;
+        static const size_t recentMax = 8;
+
+        bool changed = ImGui::Checkbox("Log Events", &logEvents);
+        for (int t = 0; t < 5; ++t) {
+            if (t % 3) ImGui::SameLine();
+            changed |= ImGui::Checkbox(eventTypeName(static_cast<EventType>(t)), &typeEnabled[t]);
+        }
+        if (changed) {
+            if (subscription) world->events.unsubscribe(subscription);
+            subscription = 0;
+            uint32_t mask = 0;
+            for (int t = 0; t < 5; ++t) {
+                if (typeEnabled[t]) mask |= eventBit(static_cast<EventType>(t));
+            }
+            if (logEvents && mask) {
+                subscription = world->events.subscribe(mask, [](Span<const PhysicsEvent> batch) {
+                    for (const auto& e : batch) ++counts[static_cast<int>(e.type)];
+                    size_t keep = std::min(batch.size(), recentMax);
+                    recent.insert(recent.end(), batch.end() - keep, batch.end());
+                    if (recent.size() > recentMax) recent.erase(recent.begin(), recent.end() - recentMax);
+                });
+            }
+        }
+
+        for (int t = 0; t < 5; ++t) {
+            ImGui::Text("%s: %llu", eventTypeName(static_cast<EventType>(t)),
+                        static_cast<unsigned long long>(counts[t]));
+        }
+        ImGui::Text("Dropped: %llu", static_cast<unsigned long long>(world->events.dropped()));
+        if (ImGui::Button("Clear Log")) {
+            for (auto& c : counts) c = 0;
+            recent.clear();
+        }
+        ImGui::Separator();
+        for (auto it = recent.rbegin(); it != recent.rend(); ++it) {
+            ImGui::Text("#%llu %s (%.2f, %.2f) %.3g", static_cast<unsigned long long>(it->step),
+                        eventTypeName(it->type), it->x, it->y, it->value);
+        }
+    }
+
     // === FORCE FIELDS ===
     if (ImGui::CollapsingHeader("Force Fields")) {
         static int fieldType = 0;
@@ -95,10 +267,21 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
         }
         
         ImGui::Separator();
+        if (ImGui::Checkbox("Bake Fields", &world->bakeForceFields)) {
+            world->markForceFieldsDirty();
+        }
+        if (world->bakeForceFields) {
+            if (ImGui::SliderInt("Bake Resolution", &world->forceFieldBakeResolution, 16, 512)) {
+                world->markForceFieldsDirty();
+            }
+        }
         ImGui::Text("Active Fields: %zu", world->forceFields.size());
         for (size_t i = 0; i < world->forceFields.size(); ++i) {
             ImGui::PushID(i);
-            ImGui::Checkbox("##active", &world->forceFields[i].active);
+            bool active = world->forceFields[i].active;
+            if (ImGui::Checkbox("##active", &active)) {
+                world->setForceFieldActive(i, active);
+            }
             ImGui::SameLine();
             ImGui::Text("Field %zu", i);
             ImGui::SameLine();
@@ -116,8 +299,31 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
     
     // === PRESET SCENARIOS ===
     if (ImGui::CollapsingHeader("Scenarios")) {
+        // Reseeding restarts the scenario streams, so the next scenario
+        // matches any other run that used the same seed
+        static unsigned long long seedInput = world->seed;
+        ImGui::InputScalar("Seed", ImGuiDataType_U64, &seedInput);
+        ImGui::SameLine();
+        if (ImGui::Button("Reseed")) {
+            world->reseed(seedInput);
+        }
+        
+        // Initial conditions from disk (.phic columnar or .csv), added to the scene
+        static char icPath[256] = "";
+        static std::string icStatus;
+        ImGui::InputText("File", icPath, sizeof(icPath));
+        if (ImGui::Button("Import")) {
+            ImportResult loaded = importInitialConditions(*world, icPath);
+            icStatus = loaded ? "Loaded " + std::to_string(loaded.imported) + " bodies" : loaded.error;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export .phic")) {
+            icStatus = exportColumnar(*world, icPath) ? "Saved" : "Could not write file";
+        }
+        if (!icStatus.empty()) ImGui::Text("%s", icStatus.c_str());
+        
         if (ImGui::Button("Solar System", ImVec2(-1, 0))) {
-            world->objects.clear();
+            world->clearObjects();
             // Sun
             auto sun = ParticleUtils::createStar(0, 0, 20.0f, 5778.0f);
             sun.isStatic = true;
@@ -148,7 +354,7 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
         }
         
         if (ImGui::Button("Binary Stars", ImVec2(-1, 0))) {
-            world->objects.clear();
+            world->clearObjects();
             auto s1 = ParticleUtils::createStar(-0.3f, 0, 6.0f, 6000.0f);
             auto s2 = ParticleUtils::createStar(0.3f, 0, 6.0f, 4500.0f);
             s1.vy = 0.08f; s2.vy = -0.08f;
@@ -157,7 +363,7 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
         }
         
         if (ImGui::Button("Black Hole + Accretion", ImVec2(-1, 0))) {
-            world->objects.clear();
+            world->clearObjects();
             auto bh = ParticleUtils::createBlackHole(0, 0, 15.0f);
             bh.isStatic = true;
             world->addObject(bh);
@@ -166,12 +372,12 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
         }
         
         if (ImGui::Button("Galaxy Formation", ImVec2(-1, 0))) {
-            world->objects.clear();
+            world->clearObjects();
             world->createGalaxy(0, 0, 3, 15);
         }
         
         if (ImGui::Button("Supernova Demo", ImVec2(-1, 0))) {
-            world->objects.clear();
+            world->clearObjects();
             auto star = ParticleUtils::createStar(0, 0, 12.0f, 8000.0f);
             star.lifetime = 5.0f; // Will go supernova in 5 seconds
             world->addObject(star);
@@ -245,8 +451,11 @@ void drawUI(UIState& state, GLFWwindow* window, PhysicsWorld* world) {
     // === VISUAL OPTIONS ===
     if (ImGui::CollapsingHeader("Visuals")) {
         ImGui::Checkbox("Show Trails", &state.showTrails);
+        ImGui::SliderInt("Trail Decimation", &state.trailDecimation, 1, 16);
         ImGui::Checkbox("Show Labels", &state.showLabels);
+        ImGui::Checkbox("Tint Sleeping", &state.showSleeping);
         ImGui::Checkbox("Show Field", &state.showField);
+        ImGui::SliderInt("Field Resolution", &state.fieldResolution, 10, 200);
         ImGui::Checkbox("Show Axes", &state.showAxes);
     }
     